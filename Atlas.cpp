@@ -0,0 +1,314 @@
+#include "Atlas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "Pipeline.h"
+
+using std::cout;
+using std::endl;
+
+static const char atlas_magic[4] = { 'A', 'T', 'L', 'S' };
+static const unsigned atlas_version = 2; // 2 dilates color into transparent texels
+
+//Mip level L averages 2^L texels, frames start on multiples of this
+static const unsigned atlas_alignment = 1 << atlas_max_mip_level;
+
+
+struct TrimmedCell {
+	unsigned cell_x, cell_y; // cell origin in the sheet
+	unsigned left, bottom; // trimmed rect inside the cell
+	unsigned width, height;
+	unsigned atlas_x = 0, atlas_y = 0;
+};
+
+static unsigned alignUp(unsigned value, unsigned alignment){
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static unsigned nextPowerOfTwo(unsigned value){
+	unsigned result = 1;
+	while (result < value)
+		result <<= 1;
+	return result;
+}
+
+//Gives the transparent texels of a slot the color of the opaque texels they
+//border, one ring further per pass, so filtering and the mips never blend in
+//the key color
+static void dilateTransparent(Atlas& atlas, unsigned slot_x, unsigned slot_y, unsigned slot_width, unsigned slot_height){
+	std::vector<unsigned char> filled(slot_width * slot_height), next;
+	for (unsigned y = 0; y < slot_height; ++y)
+		for (unsigned x = 0; x < slot_width; ++x)
+			filled[y * slot_width + x] = atlas.pixels[((slot_y + y) * atlas.width + slot_x + x) * 4 + 3] != 0;
+
+	const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+	bool changed = true;
+	while (changed){
+		changed = false;
+		next = filled;
+		for (unsigned y = 0; y < slot_height; ++y){
+			for (unsigned x = 0; x < slot_width; ++x){
+				if (filled[y * slot_width + x])
+					continue;
+
+				unsigned sum[3] = { 0, 0, 0 }, count = 0;
+				for (const int* offset : offsets){
+					int nx = int(x) + offset[0], ny = int(y) + offset[1];
+					if (nx < 0 || ny < 0 || nx >= int(slot_width) || ny >= int(slot_height) || !filled[ny * slot_width + nx])
+						continue;
+					const unsigned char* texel = &atlas.pixels[((slot_y + ny) * atlas.width + slot_x + nx) * 4];
+					for (int c = 0; c < 3; ++c)
+						sum[c] += texel[c];
+					++count;
+				}
+				if (!count)
+					continue;
+
+				unsigned char* out = &atlas.pixels[((slot_y + y) * atlas.width + slot_x + x) * 4];
+				for (int c = 0; c < 3; ++c)
+					out[c] = (unsigned char)(sum[c] / count);
+				next[y * slot_width + x] = 1;
+				changed = true;
+			}
+		}
+		filled.swap(next);
+	}
+}
+
+
+bool bakeAtlas(const unsigned char* bgr, unsigned width, unsigned height,
+	unsigned columns, unsigned rows, Atlas& atlas){
+
+	if (bgr == nullptr || columns == 0 || rows == 0 || width % columns || height % rows){
+		cout << "Sprite sheet does not divide into a " << columns << "x" << rows << " grid" << endl;
+		return false;
+	}
+
+	const unsigned cell_width = width / columns;
+	const unsigned cell_height = height / rows;
+
+	//The top left texel is the sheet background
+	const unsigned char* background = &bgr[((height - 1) * width) * 3];
+
+	auto isBackground = [&](unsigned x, unsigned y){
+		return std::memcmp(&bgr[(y * width + x) * 3], background, 3) == 0;
+	};
+
+	//Slice and trim row by row, empty cells are skipped so frames are numbered by the non empty cells in order
+	std::vector<TrimmedCell> cells;
+	for (unsigned row = 0; row < rows; ++row){
+		for (unsigned column = 0; column < columns; ++column){
+			TrimmedCell cell;
+			cell.cell_x = column * cell_width;
+			cell.cell_y = row * cell_height;
+
+			unsigned left = cell_width, right = 0, bottom = cell_height, top = 0;
+			for (unsigned y = 0; y < cell_height; ++y){
+				for (unsigned x = 0; x < cell_width; ++x){
+					if (isBackground(cell.cell_x + x, cell.cell_y + y))
+						continue;
+					left = std::min(left, x);
+					right = std::max(right, x + 1);
+					bottom = std::min(bottom, y);
+					top = std::max(top, y + 1);
+				}
+			}
+
+			if (right <= left || top <= bottom)
+				continue;
+
+			cell.left = left;
+			cell.bottom = bottom;
+			cell.width = right - left;
+			cell.height = top - bottom;
+			cells.push_back(cell);
+		}
+	}
+
+	if (cells.empty()){
+		cout << "Sprite sheet has no frames" << endl;
+		return false;
+	}
+
+	//Shelf pack tallest first, each slot is the frame plus a gutter on every side
+	std::vector<TrimmedCell*> order;
+	unsigned area = 0;
+	for (TrimmedCell& cell : cells){
+		order.push_back(&cell);
+		area += alignUp(cell.width + 2 * atlas_gutter, atlas_alignment) *
+			alignUp(cell.height + 2 * atlas_gutter, atlas_alignment);
+	}
+	std::stable_sort(order.begin(), order.end(), [](const TrimmedCell* a, const TrimmedCell* b){
+		return a->height > b->height;
+	});
+
+	unsigned atlas_width = nextPowerOfTwo(unsigned(std::sqrt(double(area))));
+	unsigned shelf_x = 0, shelf_y = 0, shelf_height = 0;
+	for (TrimmedCell* cell : order){
+		unsigned slot_width = alignUp(cell->width + 2 * atlas_gutter, atlas_alignment);
+		unsigned slot_height = alignUp(cell->height + 2 * atlas_gutter, atlas_alignment);
+		atlas_width = std::max(atlas_width, nextPowerOfTwo(slot_width));
+
+		if (shelf_x + slot_width > atlas_width){
+			shelf_x = 0;
+			shelf_y += shelf_height;
+			shelf_height = 0;
+		}
+
+		cell->atlas_x = shelf_x + atlas_gutter;
+		cell->atlas_y = shelf_y + atlas_gutter;
+		shelf_x += slot_width;
+		shelf_height = std::max(shelf_height, slot_height);
+	}
+
+	atlas.width = atlas_width;
+	atlas.height = shelf_y + shelf_height;
+	atlas.pixels.assign(atlas.width * atlas.height * 4, 0);
+	atlas.frames.clear();
+
+	//Copy frames, clamping the source into the gutter repeats the edge texels
+	for (const TrimmedCell& cell : cells){
+		for (unsigned y = 0; y < cell.height + 2 * atlas_gutter; ++y){
+			for (unsigned x = 0; x < cell.width + 2 * atlas_gutter; ++x){
+				int source_x = std::min(std::max(int(x) - int(atlas_gutter), 0), int(cell.width) - 1);
+				int source_y = std::min(std::max(int(y) - int(atlas_gutter), 0), int(cell.height) - 1);
+				unsigned sheet_x = cell.cell_x + cell.left + source_x;
+				unsigned sheet_y = cell.cell_y + cell.bottom + source_y;
+
+				const unsigned char* texel = &bgr[(sheet_y * width + sheet_x) * 3];
+				unsigned char* out = &atlas.pixels[((cell.atlas_y - atlas_gutter + y) * atlas.width +
+					cell.atlas_x - atlas_gutter + x) * 4];
+				out[0] = texel[2];
+				out[1] = texel[1];
+				out[2] = texel[0];
+				out[3] = isBackground(sheet_x, sheet_y) ? 0 : 255;
+			}
+		}
+		dilateTransparent(atlas, cell.atlas_x - atlas_gutter, cell.atlas_y - atlas_gutter,
+			alignUp(cell.width + 2 * atlas_gutter, atlas_alignment), alignUp(cell.height + 2 * atlas_gutter, atlas_alignment));
+
+		AtlasFrame frame;
+		frame.uv = glm::vec4(float(cell.atlas_x) / atlas.width, float(cell.atlas_y) / atlas.height,
+			float(cell.width) / atlas.width, float(cell.height) / atlas.height);
+
+		//Trimmed rect in the -1..1 space of the quad that used to show the whole cell
+		float left = -1.0f + 2.0f * cell.left / cell_width;
+		float right = -1.0f + 2.0f * (cell.left + cell.width) / cell_width;
+		float bottom = -1.0f + 2.0f * cell.bottom / cell_height;
+		float top = -1.0f + 2.0f * (cell.bottom + cell.height) / cell_height;
+		frame.quad = glm::vec4(0.5f * (left + right), 0.5f * (bottom + top),
+			0.5f * (right - left), 0.5f * (top - bottom));
+
+		atlas.frames.push_back(frame);
+	}
+
+	if (atlas.frames.size() > frame_table_size){
+		cout << "Sprite sheet has " << atlas.frames.size() << " frames, the frame table holds "
+			<< frame_table_size << endl;
+		atlas.frames.resize(frame_table_size);
+	}
+
+	return true;
+}
+
+
+bool saveAtlas(const std::string& path, const Atlas& atlas){
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file){
+		cout << path << " could not be opened for writing" << endl;
+		return false;
+	}
+
+	unsigned header[4] = { atlas_version, atlas.width, atlas.height, unsigned(atlas.frames.size()) };
+	fwrite(atlas_magic, 1, sizeof(atlas_magic), file);
+	fwrite(header, sizeof(unsigned), 4, file);
+	fwrite(atlas.frames.data(), sizeof(AtlasFrame), atlas.frames.size(), file);
+	fwrite(atlas.pixels.data(), 1, atlas.pixels.size(), file);
+
+	bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok;
+}
+
+bool loadAtlas(const std::string& path, Atlas& atlas){
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	char magic[4];
+	unsigned header[4];
+	if (fread(magic, 1, 4, file) != 4 || std::memcmp(magic, atlas_magic, 4) != 0 ||
+		fread(header, sizeof(unsigned), 4, file) != 4 || header[0] != atlas_version ||
+		header[3] > frame_table_size){
+		cout << path << " is not a baked atlas, rerun AtlasBaker" << endl;
+		fclose(file);
+		return false;
+	}
+
+	//The header sizes the allocation, so it has to agree with what is left of the file first
+	long data_start = ftell(file);
+	fseek(file, 0, SEEK_END);
+	long file_size = ftell(file);
+	fseek(file, data_start, SEEK_SET);
+	unsigned long long expected = header[3] * (unsigned long long)sizeof(AtlasFrame) +
+		(unsigned long long)header[1] * header[2] * 4;
+	if (header[1] == 0 || header[2] == 0 || header[1] > atlas_max_size || header[2] > atlas_max_size ||
+		data_start < 0 || file_size < data_start || (unsigned long long)(file_size - data_start) != expected){
+		cout << path << " is truncated or its header is corrupt, rerun AtlasBaker" << endl;
+		fclose(file);
+		return false;
+	}
+
+	atlas.width = header[1];
+	atlas.height = header[2];
+	atlas.frames.resize(header[3]);
+	atlas.pixels.resize(atlas.width * atlas.height * 4);
+
+	bool ok = fread(atlas.frames.data(), sizeof(AtlasFrame), atlas.frames.size(), file) == atlas.frames.size() &&
+		fread(atlas.pixels.data(), 1, atlas.pixels.size(), file) == atlas.pixels.size();
+	fclose(file);
+
+	if (!ok)
+		cout << path << " is truncated" << endl;
+	return ok;
+}
+
+
+TextureHandle createAtlasTexture(const Atlas& atlas){
+	TextureHandle texture = makeTexture("sprite atlas");
+	glBindTexture(GL_TEXTURE_2D, texture.get());
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlas.width, atlas.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.pixels.data());
+	texture.setBytes(textureBytes(atlas.width, atlas.height, 4, atlas_max_mip_level));
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	//Deeper levels would average across the gutter into the next frame
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, atlas_max_mip_level);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	return texture;
+}
+
+BufferHandle createFrameTable(const Atlas& atlas){
+	//std140, frame_uv[frame_table_size] then frame_quad[frame_table_size]
+	std::vector<glm::vec4> block(2 * frame_table_size, glm::vec4(0.0f));
+	for (std::size_t i = 0; i < atlas.frames.size(); ++i){
+		block[i] = atlas.frames[i].uv;
+		block[frame_table_size + i] = atlas.frames[i].quad;
+	}
+
+	BufferHandle buffer = makeBuffer("frame table");
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer.get());
+	bufferData(buffer, GL_UNIFORM_BUFFER, block.size() * sizeof(glm::vec4), block.data(), GL_STATIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, frame_table_binding, buffer.get());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	return buffer;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "Resources.h"
+
+/*
+Description
+
+Baked sprite sheet atlas
+
+The sheet is sliced into grid cells, every cell is trimmed down to the pixels
+that differ from the background color and the frames are repacked on shelves
+with a gutter around each one.  The gutter repeats the frame's edge texels and
+frames start on mip aligned texels, so mip levels up to atlas_max_mip_level
+never blend neighbouring frames.  Transparent texels take the color of the
+nearest opaque ones, so the background key never shows at the edges.
+
+Each frame records its UV rect and where the trimmed quad sits inside the
+original cell, the animation shader reads both from the FrameTable UBO.
+
+*/
+
+const unsigned atlas_gutter = 4;
+const unsigned atlas_max_mip_level = 2; // 1 << 2 == atlas_gutter
+const unsigned atlas_max_size = 8192; // largest baked atlas side loadAtlas accepts
+
+struct AtlasFrame {
+	glm::vec4 uv; // u, v, width, height in the atlas
+	glm::vec4 quad; // pivot x, y and half extent x, y inside the -1..1 cell
+};
+
+struct Atlas {
+	unsigned width = 0;
+	unsigned height = 0;
+	std::vector<unsigned char> pixels; // RGBA rows bottom up, like load_bmp
+	std::vector<AtlasFrame> frames;
+};
+
+//Slices a BGR sheet from load_bmp, empty cells are dropped from the frame table
+bool bakeAtlas(const unsigned char* bgr, unsigned width, unsigned height,
+	unsigned columns, unsigned rows, Atlas& atlas);
+
+bool saveAtlas(const std::string& path, const Atlas& atlas);
+bool loadAtlas(const std::string& path, Atlas& atlas);
+
+//Mipmapped RGBA texture, same wrap setup as the other sprite textures
+TextureHandle createAtlasTexture(const Atlas& atlas);
+
+//std140 FrameTable block bound to frame_table_binding
+BufferHandle createFrameTable(const Atlas& atlas);
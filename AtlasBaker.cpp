@@ -0,0 +1,54 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include "Atlas.h"
+#include "Bitmap.h"
+
+/*
+Description
+
+Offline sprite sheet baker
+
+AtlasBaker <sheet.bmp> <columns> <rows> <out.atlas>
+
+Writes the trimmed, padded atlas and its frame table.  The demo loads
+Mario.atlas when it exists and bakes Mario.bmp at startup otherwise.
+
+*/
+
+using std::cout;
+using std::endl;
+
+int main(int argc, char* argv[]){
+
+	if (argc != 5){
+		cout << "Usage: AtlasBaker <sheet.bmp> <columns> <rows> <out.atlas>" << endl;
+		return 1;
+	}
+
+	unsigned int width{ 0 }, height{ 0 };
+	std::unique_ptr<unsigned char[]> data(load_bmp(argv[1], width, height));
+	if (!data)
+		return 1;
+
+	Atlas atlas;
+	if (!bakeAtlas(data.get(), width, height, std::atoi(argv[2]), std::atoi(argv[3]), atlas))
+		return 1;
+
+	if (!saveAtlas(argv[4], atlas))
+		return 1;
+
+	cout << "Baked " << atlas.frames.size() << " frames into a "
+		<< atlas.width << "x" << atlas.height << " atlas" << endl;
+
+	for (std::size_t i = 0; i < atlas.frames.size(); ++i){
+		const AtlasFrame& frame = atlas.frames[i];
+		printf("frame %2zu  uv %.4f %.4f %.4f %.4f  pivot %.3f %.3f  extent %.3f %.3f\n", i,
+			frame.uv.x, frame.uv.y, frame.uv.z, frame.uv.w,
+			frame.quad.x, frame.quad.y, frame.quad.z, frame.quad.w);
+	}
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include "Bitmap.h"
+
+#include <cstdio>
+#include <iostream>
+
+unsigned char* load_bmp(std::string image_path, unsigned int& width, unsigned int& height){
+	using namespace std;
+
+	cout << "Reading image: " << image_path << endl;
+
+	// Data read from the header of the BMP file
+	unsigned char header[54];
+	unsigned int dataPos;
+	unsigned int imageSize;
+	//unsigned int width, height;
+	// Actual RGB data
+	unsigned char * data;
+
+	// Open the file
+	FILE * file = fopen(image_path.c_str(), "rb");
+	if (!file)							    {
+		cout << image_path << "could not be opened. Are you in the right directory ? Don't forget to read the FAQ !" << endl;
+		getchar();
+		return nullptr;
+	}
+
+	// Read the header, i.e. the 54 first bytes
+
+	// If less than 54 bytes are read, problem
+	if (fread(header, 1, 54, file) != 54){
+		cout << "Not a correct BMP file" << endl;
+		return nullptr;
+	}
+	// A BMP files always begins with "BM"
+	if (header[0] != 'B' || header[1] != 'M'){
+		cout << "Not a correct BMP file" << endl;
+		return nullptr;
+	}
+	// Make sure this is a 24bpp file
+	if (*(int*)&(header[0x1E]) != 0)         {
+		cout << "Not a correct BMP file" << endl;
+		return nullptr;
+	}
+	if (*(int*)&(header[0x1C]) != 24)         {
+		cout << "Not a correct BMP file" << endl;
+		return nullptr;
+	}
+
+	// Read the information about the image
+	dataPos = *(int*)&(header[0x0A]);
+	imageSize = *(int*)&(header[0x22]);
+	width = *(int*)&(header[0x12]);
+	height = *(int*)&(header[0x16]);
+
+	// Some BMP files are misformatted, guess missing information
+	if (imageSize == 0)    imageSize = width*height * 3; // 3 : one byte for each Red, Green and Blue component
+	if (dataPos == 0)      dataPos = 54; // The BMP header is done that way
+
+	// Create a buffer
+	data = new unsigned char[imageSize];
+
+	// Read the actual data from the file into the buffer
+	fread(data, 1, imageSize, file);
+
+	// Everything is in memory now, the file wan be closed
+	fclose(file);
+
+	return data;
+}
+
+TextureHandle createBmpTexture(const unsigned char* bgr, unsigned width, unsigned height, const char* label){
+	TextureHandle texture = makeTexture(label);
+
+	glBindTexture(GL_TEXTURE_2D, texture.get());
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, bgr);
+	texture.setBytes(textureBytes(width, height, 3));
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	return texture;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+#include <GL/glew.h>
+
+#include "Resources.h"
+
+//Reads a 24bpp BMP, returns BGR rows bottom up allocated with new[]
+unsigned char* load_bmp(std::string image_path, unsigned int& width, unsigned int& height);
+
+//Texture setup shared by the title and the tile sets, clamped and unfiltered
+TextureHandle createBmpTexture(const unsigned char* bgr, unsigned width, unsigned height, const char* label = "bmp texture");
@@ -0,0 +1,111 @@
+#include "Collision.h"
+
+#include <algorithm>
+#include <cmath>
+
+glm::vec2 getCollisionVector(Sprite& sprite1, Sprite& sprite2){
+	ContactManifold contact;
+	if (!getContact(sprite1.pos, sprite1.size, sprite2.pos, sprite2.size, contact))
+		return glm::vec2();
+
+	return contact.normal * contact.penetration;
+}
+
+bool getContact(glm::vec2 pos1, glm::vec2 half1, glm::vec2 pos2, glm::vec2 half2, ContactManifold& contact){
+	glm::vec2 distance = pos2 - pos1;
+	float overlap_x = half1.x + half2.x - std::fabs(distance.x);
+	float overlap_y = half1.y + half2.y - std::fabs(distance.y);
+	if (overlap_x < 0.0f || overlap_y < 0.0f)
+		return false;
+
+	//Ties go to x so a head on hit reflects horizontally like the old response
+	if (overlap_x <= overlap_y){
+		contact.normal = glm::vec2(distance.x < 0.0f ? -1.0f : 1.0f, 0.0f);
+		contact.penetration = overlap_x;
+	}
+	else {
+		contact.normal = glm::vec2(0.0f, distance.y < 0.0f ? -1.0f : 1.0f);
+		contact.penetration = overlap_y;
+	}
+	return true;
+}
+
+PhysicsMaterial combineMaterials(const PhysicsMaterial& material1, const PhysicsMaterial& material2){
+	PhysicsMaterial material;
+	material.restitution = std::max(material1.restitution, material2.restitution);
+	material.friction = std::sqrt(material1.friction * material2.friction);
+	return material;
+}
+
+bool resolveStaticContact(const ContactManifold& contact, const PhysicsMaterial& material,
+	glm::vec2& pos, glm::vec2& velocity){
+
+	//Separate first so the next tick does not see the same overlap and flip again
+	pos += contact.normal * contact.penetration;
+
+	float normal_speed = velocity.x * contact.normal.x + velocity.y * contact.normal.y;
+	if (normal_speed >= 0.0f)
+		return false;
+
+	glm::vec2 tangent(-contact.normal.y, contact.normal.x);
+	float tangent_speed = velocity.x * tangent.x + velocity.y * tangent.y;
+
+	//Friction impulse is capped by the normal impulse, Coulomb style
+	float normal_impulse = -(1.0f + material.restitution) * normal_speed;
+	float friction_impulse = std::min(std::fabs(tangent_speed), material.friction * normal_impulse);
+	if (tangent_speed > 0.0f)
+		friction_impulse = -friction_impulse;
+
+	velocity += contact.normal * normal_impulse + tangent * friction_impulse;
+	return true;
+}
+
+bool collision(Sprite& sprite1, Sprite& sprite2){
+	Rectangle box1 = sprite1.getBoundingBox();
+	Rectangle box2 = sprite2.getBoundingBox();
+
+	if (box1.bottom > box2.top) return false;
+	if (box1.top < box2.bottom) return false;
+	if (box1.right < box2.left) return false;
+	if (box1.left > box2.right) return false;
+
+	return true;
+
+}
+
+glm::vec2& getBallVelocity(glm::vec2& pos, glm::vec2& velocity ){
+
+	float xsize = ball_size;	
+	float ysize = ball_size;
+
+	if ((pos.x - xsize) < -1) {
+		//std::cout << "Pos x: " << pos.x << " Negative Collision" << std::endl;
+		//pos.x = -1 + xsize; // may want to comment out?
+		velocity.x *= -1;
+		
+	}
+
+	if ((pos.x + xsize) > 1) {
+		//std::cout << "Pos x: " << pos.x << "Positive Collision" << std::endl;
+		//pos.x = 1 - xsize; // may want to comment out?
+		velocity.x *=-1;
+		
+	}
+
+
+	if ((pos.y - ysize) < -1) {
+		//std::cout << "Pos x: " << pos.x << " Negative Collision" << std::endl;
+		//pos.x = -1 + xsize; // may want to comment out?
+		velocity.y *= -1;
+
+	}
+
+	if ((pos.y + ysize) > 1) {
+		//std::cout << "Pos x: " << pos.x << "Positive Collision" << std::endl;
+		//pos.x = 1 - xsize; // may want to comment out?
+		velocity.y *= -1;
+
+	}
+
+	return velocity;
+}
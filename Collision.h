@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Sprite.h"
+
+const float paddle_size = 0.15f;
+const float ball_size = 0.05f;
+const float ball_speed = 0.5f; //3 units per second
+
+//The ball keeps its speed off the paddles, friction only trims the sliding part
+const PhysicsMaterial paddle_material{ 1.0f, 0.3f };
+const PhysicsMaterial ball_material{ 1.0f, 0.1f };
+
+//Overlap of two boxes, the normal points from the first box to the second
+struct ContactManifold {
+	glm::vec2 normal{ 0.0f, 0.0f };
+	float penetration = 0.0f;
+};
+
+bool collision(Sprite& sprite1, Sprite& sprite2);
+
+//Moves sprite2 out of sprite1, zero when they do not overlap
+glm::vec2 getCollisionVector(Sprite& sprite1, Sprite& sprite2);
+
+//Separating axis of two AABBs given by center and half size, the axis of least
+//penetration is the normal.  Touching boxes count as a contact with zero depth.
+bool getContact(glm::vec2 pos1, glm::vec2 half1, glm::vec2 pos2, glm::vec2 half2, ContactManifold& contact);
+
+//Per pair material, the bouncier restitution and the geometric mean of the frictions
+PhysicsMaterial combineMaterials(const PhysicsMaterial& material1, const PhysicsMaterial& material2);
+
+//Contact against a body that does not move, such as a paddle.  Pushes pos out
+//along the normal and applies restitution and friction to velocity when the
+//body is approaching, returns false when it was already separating.
+bool resolveStaticContact(const ContactManifold& contact, const PhysicsMaterial& material,
+	glm::vec2& pos, glm::vec2& velocity);
+
+//Flips the velocity of a ball_size ball that left the -1..1 box
+glm::vec2& getBallVelocity(glm::vec2& pos, glm::vec2& velocity );
@@ -0,0 +1,128 @@
+#include "DrawSort.h"
+
+#include <algorithm>
+#include <array>
+
+const unsigned layer_shift = 56;
+const unsigned blend_shift = 54;
+const unsigned depth_shift = 30;
+const unsigned program_shift = 22;
+const unsigned texture_shift = 6;
+
+const unsigned radix_bits = 8;
+const unsigned radix_buckets = 1 << radix_bits;
+const unsigned radix_passes = 64 / radix_bits;
+const std::size_t radix_min_task = 1 << 14; // entries per task before another one is worth it
+
+typedef std::array<std::uint32_t, radix_buckets> Histogram;
+
+
+SortKey makeSortKey(unsigned layer, BlendMode blend, unsigned program, unsigned texture, float depth){
+	depth = std::min(std::max(depth, 0.0f), 1.0f);
+	SortKey quantized = SortKey(depth * sort_key_depth_max);
+
+	program &= sort_key_programs - 1;
+	texture &= sort_key_textures - 1;
+
+	//Far to near, the larger depth has to sort first
+	return SortKey(layer & (sort_key_layers - 1)) << layer_shift | SortKey(blend) << blend_shift
+		| (sort_key_depth_max - quantized) << depth_shift
+		| SortKey(program) << program_shift | SortKey(texture) << texture_shift;
+}
+
+unsigned getKeyLayer(SortKey key){
+	return unsigned(key >> layer_shift);
+}
+
+BlendMode getKeyBlend(SortKey key){
+	return BlendMode(key >> blend_shift & 3);
+}
+
+unsigned getKeyProgram(SortKey key){
+	return unsigned(key >> program_shift) & (sort_key_programs - 1);
+}
+
+unsigned getKeyTexture(SortKey key){
+	return unsigned(key >> texture_shift) & (sort_key_textures - 1);
+}
+
+
+void sortEntries(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch, WorkerPool* pool){
+	const std::size_t count = entries.size();
+	scratch.resize(count);
+	if (count < 2)
+		return;
+
+	//Bits that differ between any two keys, a pass over a digit without any is skipped
+	SortKey all_or = 0, all_and = ~SortKey(0);
+	for (const SortEntry& entry : entries){
+		all_or |= entry.key;
+		all_and &= entry.key;
+	}
+	const SortKey varying = all_or ^ all_and;
+
+	std::size_t tasks = 1;
+	if (pool)
+		tasks = std::max<std::size_t>(1, std::min<std::size_t>(pool->size(), count / radix_min_task));
+	std::vector<Histogram> histograms(tasks);
+
+	auto run = [&](const auto& job){
+		if (tasks == 1)
+			job(0);
+		else
+			pool->run(tasks, job);
+	};
+
+	SortEntry* source = entries.data();
+	SortEntry* destination = scratch.data();
+	for (unsigned pass = 0; pass < radix_passes; ++pass){
+		const unsigned shift = pass * radix_bits;
+		if (!(varying >> shift & (radix_buckets - 1)))
+			continue;
+
+		run([&](std::size_t task){
+			Histogram& histogram = histograms[task];
+			histogram.fill(0);
+			std::size_t first = count * task / tasks, last = count * (task + 1) / tasks;
+			for (std::size_t i = first; i < last; ++i)
+				++histogram[source[i].key >> shift & (radix_buckets - 1)];
+		});
+
+		//Bucket major, task minor, so equal digits keep their order and the sort stays stable
+		std::uint32_t offset = 0;
+		for (unsigned bucket = 0; bucket < radix_buckets; ++bucket){
+			for (Histogram& histogram : histograms){
+				std::uint32_t bucket_count = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucket_count;
+			}
+		}
+
+		run([&](std::size_t task){
+			Histogram& histogram = histograms[task];
+			std::size_t first = count * task / tasks, last = count * (task + 1) / tasks;
+			for (std::size_t i = first; i < last; ++i)
+				destination[histogram[source[i].key >> shift & (radix_buckets - 1)]++] = source[i];
+		});
+
+		std::swap(source, destination);
+	}
+
+	if (source != entries.data())
+		entries.swap(scratch);
+}
+
+unsigned countStateChanges(const SortEntry* entries, std::size_t count){
+	unsigned changes = 0;
+	int blend = -1, program = -1, texture = -1;
+	for (std::size_t i = 0; i < count; ++i){
+		SortKey key = entries[i].key;
+		int next_blend = getKeyBlend(key), next_program = int(getKeyProgram(key)), next_texture = int(getKeyTexture(key));
+		if (next_blend != blend || next_program != program || next_texture != texture)
+			++changes;
+		blend = next_blend;
+		program = next_program;
+		texture = next_texture;
+	}
+	return changes;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "WorkerPool.h"
+
+/*
+Description
+
+64 bit draw order keys and the radix sort that orders draw packets by them
+
+A key packs everything that decides when a packet is drawn, most significant
+first, so sorting the keys as plain integers gives the submission order:
+
+	63..56  layer         background to foreground
+	55..54  blend mode    opaque, then alpha, then additive
+	53..30  depth         far to near
+	29..22  program
+	21..6   texture
+
+The scene draws without a depth buffer, so opaque packets are painted back to
+front like blended ones and the nearer sprite ends up on top.  Packets at the
+same depth, which is most of them, are grouped by program then texture so the
+state only changes between groups.
+
+Packets are not moved, a SortEntry of key and packet index is sorted instead.
+The sort is an LSD radix sort on 8 bit digits.  Each pass counts the digit in
+per task histograms and scatters in parallel, and passes whose digit is the
+same in every key are skipped, which is most of them when there are a few
+layers, programs and textures.
+
+*/
+
+typedef std::uint64_t SortKey;
+
+enum BlendMode { BLEND_OPAQUE, BLEND_ALPHA, BLEND_ADDITIVE };
+
+const unsigned sort_key_layers = 1 << 8;
+const unsigned sort_key_programs = 1 << 8;
+const unsigned sort_key_textures = 1 << 16;
+const std::uint32_t sort_key_depth_max = (1u << 24) - 1;
+
+//depth is 0 for the nearest sprite and 1 for the farthest, clamped
+SortKey makeSortKey(unsigned layer, BlendMode blend, unsigned program, unsigned texture, float depth);
+
+unsigned getKeyLayer(SortKey key);
+BlendMode getKeyBlend(SortKey key);
+unsigned getKeyProgram(SortKey key);
+unsigned getKeyTexture(SortKey key);
+
+struct SortEntry {
+	SortKey key;
+	std::uint32_t index; // packet the key belongs to
+};
+
+//Stable, scratch is resized to match.  pool may be nullptr to sort on the calling thread.
+void sortEntries(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch, WorkerPool* pool = nullptr);
+
+//Blend, program or texture switches needed to submit the entries in this order, the first packet counts as one
+unsigned countStateChanges(const SortEntry* entries, std::size_t count);
@@ -0,0 +1,454 @@
+#include "Particles.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PARTICLES_SSE2 1
+#endif
+
+#include "Pipeline.h"
+
+using std::cout;
+using std::endl;
+
+//Interleaved GPU vertex, position, velocity, life
+const int particle_floats = 5;
+const GLsizei particle_stride = particle_floats * sizeof(GLfloat);
+
+const float particle_box = 1.0f;
+
+
+static const std::string vs_particle_update =
+{
+	"#version 330 core                                                 \n"
+	"                                                                  \n"
+	"layout(location = 0) in vec2 position;                            \n"
+	"layout(location = 1) in vec2 velocity;                            \n"
+	"layout(location = 2) in float life;                               \n"
+	"                                                                  \n"
+	"uniform float delta_time;                                         \n"
+	"                                                                  \n"
+	"out vec2 out_position;                                            \n"
+	"out vec2 out_velocity;                                            \n"
+	"out float out_life;                                               \n"
+	"                                                                  \n"
+	"void main(){                                                      \n"
+	"    vec2 v = velocity;                                            \n"
+	"    v = mix(v, abs(v), lessThan(position, vec2(-1.0)));           \n"
+	"    v = mix(v, -abs(v), greaterThan(position, vec2(1.0)));        \n"
+	"                                                                  \n"
+	"    out_position = position + v * delta_time;                    \n"
+	"    out_velocity = v;                                             \n"
+	"    out_life = life - delta_time;                                 \n"
+	"}                                                                 \n"
+};
+
+//Position is split into x and y so the CPU backend can draw straight from its SoA arrays
+static const std::string vs_particle_render =
+{
+	"#version 330 core                                                 \n"
+	"                                                                  \n"
+	"layout(location = 0) in float position_x;                         \n"
+	"layout(location = 1) in float position_y;                         \n"
+	"layout(location = 2) in float life;                               \n"
+	"                                                                  \n"
+	"smooth out float fade;                                            \n"
+	"                                                                  \n"
+	"void main(){                                                      \n"
+	"    gl_Position = life > 0.0 ? vec4(position_x, position_y, 0, 1) \n"
+	"                             : vec4(2.0, 2.0, 2.0, 1.0);          \n"
+	"    fade = clamp(life, 0.0, 1.0);                                 \n"
+	"}                                                                 \n"
+};
+
+static const std::string fs_particle_render =
+{
+	"#version 330 core                                                 \n"
+	"                                                                  \n"
+	"smooth in float fade;                                             \n"
+	"uniform vec4 particle_color;                                      \n"
+	"                                                                  \n"
+	"out vec4 output_color;                                            \n"
+	"                                                                  \n"
+	"void main(void)                                                   \n"
+	"{                                                                 \n"
+	"    output_color = vec4(particle_color.rgb, particle_color.a * fade);\n"
+	"}                                                                 \n"
+};
+
+
+void ParticleArrays::resize(std::size_t capacity){
+	x.assign(capacity, 0.0f);
+	y.assign(capacity, 0.0f);
+	vx.assign(capacity, 0.0f);
+	vy.assign(capacity, 0.0f);
+	life.assign(capacity, 0.0f);
+}
+
+
+static inline void bounce(float& pos, float& velocity, float deltaTime){
+	if (pos < -particle_box)
+		velocity = std::fabs(velocity);
+	if (pos > particle_box)
+		velocity = -std::fabs(velocity);
+	pos += velocity * deltaTime;
+}
+
+void updateParticlesScalar(ParticleArrays& particles, std::size_t count, float deltaTime){
+	float* x = particles.x.data();
+	float* y = particles.y.data();
+	float* vx = particles.vx.data();
+	float* vy = particles.vy.data();
+	float* life = particles.life.data();
+
+	for (std::size_t i = 0; i < count; ++i){
+		bounce(x[i], vx[i], deltaTime);
+		bounce(y[i], vy[i], deltaTime);
+		life[i] -= deltaTime;
+	}
+}
+
+#ifdef PARTICLES_SSE2
+
+//Branchless bounce, velocity becomes |v| below the box and -|v| above it
+static inline void bounce4(float* pos, float* velocity, __m128 dt){
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 low = _mm_set1_ps(-particle_box);
+	const __m128 high = _mm_set1_ps(particle_box);
+
+	__m128 p = _mm_loadu_ps(pos);
+	__m128 v = _mm_loadu_ps(velocity);
+	__m128 magnitude = _mm_andnot_ps(sign, v);
+
+	__m128 below = _mm_cmplt_ps(p, low);
+	__m128 above = _mm_cmpgt_ps(p, high);
+	v = _mm_or_ps(_mm_and_ps(below, magnitude), _mm_andnot_ps(below, v));
+	v = _mm_or_ps(_mm_and_ps(above, _mm_or_ps(magnitude, sign)), _mm_andnot_ps(above, v));
+
+	_mm_storeu_ps(velocity, v);
+	_mm_storeu_ps(pos, _mm_add_ps(p, _mm_mul_ps(v, dt)));
+}
+
+void updateParticlesSimd(ParticleArrays& particles, std::size_t count, float deltaTime){
+	float* x = particles.x.data();
+	float* y = particles.y.data();
+	float* vx = particles.vx.data();
+	float* vy = particles.vy.data();
+	float* life = particles.life.data();
+
+	const __m128 dt = _mm_set1_ps(deltaTime);
+
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4){
+		bounce4(x + i, vx + i, dt);
+		bounce4(y + i, vy + i, dt);
+		_mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), dt));
+	}
+
+	for (; i < count; ++i){
+		bounce(x[i], vx[i], deltaTime);
+		bounce(y[i], vy[i], deltaTime);
+		life[i] -= deltaTime;
+	}
+}
+
+#else
+
+//No SSE2, the scalar loop is simple enough for the compiler to vectorize
+void updateParticlesSimd(ParticleArrays& particles, std::size_t count, float deltaTime){
+	updateParticlesScalar(particles, count, deltaTime);
+}
+
+#endif
+
+
+ParticleBackend chooseParticleBackend(){
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	if (renderer == nullptr)
+		return PARTICLES_CPU;
+
+	std::string name(renderer);
+	if (name.find("llvmpipe") != std::string::npos ||
+		name.find("softpipe") != std::string::npos ||
+		name.find("Software") != std::string::npos)
+		return PARTICLES_CPU;
+
+	return PARTICLES_GPU;
+}
+
+
+static ProgramHandle linkParticleProgram(const std::string& vs_source, const std::string* fs_source,
+	const char* const* varyings, GLsizei varying_count, const char* label){
+	GLuint program = glCreateProgram();
+	GLuint vs = createShader(GL_VERTEX_SHADER, vs_source);
+	glAttachShader(program, vs);
+
+	GLuint fs = 0;
+	if (fs_source){
+		fs = createShader(GL_FRAGMENT_SHADER, *fs_source);
+		glAttachShader(program, fs);
+	}
+
+	//Has to be declared before linking
+	if (varyings)
+		glTransformFeedbackVaryings(program, varying_count, varyings, GL_INTERLEAVED_ATTRIBS);
+
+	glLinkProgram(program);
+	glDeleteShader(vs);
+	if (fs)
+		glDeleteShader(fs);
+
+	GLint pass_fail;
+	glGetProgramiv(program, GL_LINK_STATUS, &pass_fail);
+	if (pass_fail != GL_TRUE)
+		cout << "WARNING PARTICLE PROGRAM DID NOT LINK" << endl;
+
+	return ProgramHandle(program, label);
+}
+
+
+ParticleSystem::ParticleSystem(ParticleBackend backend, std::size_t capacity) :
+	backend(backend), capacity(capacity) {
+
+	createRenderProgram();
+
+	if (backend == PARTICLES_GPU)
+		createGpuBuffers();
+	else
+		createCpuBuffers();
+}
+
+void ParticleSystem::createRenderProgram(){
+	renderProgram = linkParticleProgram(vs_particle_render, &fs_particle_render, nullptr, 0, "particle render");
+	particleColorPos = glGetUniformLocation(renderProgram.get(), "particle_color");
+}
+
+void ParticleSystem::createGpuBuffers(){
+	static const char* varyings[] = { "out_position", "out_velocity", "out_life" };
+	updateProgram = linkParticleProgram(vs_particle_update, nullptr, varyings, 3, "particle update");
+	deltaTimePos = glGetUniformLocation(updateProgram.get(), "delta_time");
+
+	//Zero life, nothing is drawn until the first emit
+	std::vector<GLfloat> empty(capacity * particle_floats, 0.0f);
+
+	for (int i = 0; i < 2; ++i){
+		gpuBuffer[i] = makeBuffer("particle state");
+		updateVAO[i] = makeVertexArray("particle update");
+		renderVAO[i] = makeVertexArray("particle render");
+
+		glBindBuffer(GL_ARRAY_BUFFER, gpuBuffer[i].get());
+		bufferData(gpuBuffer[i], GL_ARRAY_BUFFER, empty.size() * sizeof(GLfloat), empty.data(), GL_DYNAMIC_COPY);
+
+		glBindVertexArray(updateVAO[i].get());
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, particle_stride, (void*)0);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, particle_stride, (void*)(2 * sizeof(GLfloat)));
+		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, particle_stride, (void*)(4 * sizeof(GLfloat)));
+
+		glBindVertexArray(renderVAO[i].get());
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, particle_stride, (void*)0);
+		glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, particle_stride, (void*)(1 * sizeof(GLfloat)));
+		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, particle_stride, (void*)(4 * sizeof(GLfloat)));
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleSystem::createCpuBuffers(){
+	particles.resize(capacity);
+	particles_memory.setBytes(5 * capacity * sizeof(float));
+
+	//SoA upload, all x then all y then all life
+	GLsizeiptr block = capacity * sizeof(GLfloat);
+
+	cpuBuffer = makeBuffer("particle upload");
+	glBindBuffer(GL_ARRAY_BUFFER, cpuBuffer.get());
+	bufferData(cpuBuffer, GL_ARRAY_BUFFER, 3 * block, nullptr, GL_STREAM_DRAW);
+
+	cpuVAO = makeVertexArray("particle upload");
+	glBindVertexArray(cpuVAO.get());
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, (void*)block);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 0, (void*)(2 * block));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void ParticleSystem::emit(glm::vec2 pos, glm::vec2 velocity, float spread, float life, unsigned amount){
+	if (amount > capacity)
+		amount = (unsigned)capacity;
+
+	std::uniform_real_distribution<float> jitter(-spread, spread);
+	std::uniform_real_distribution<float> lifetime(0.5f * life, life);
+
+	staging.resize(amount * particle_floats);
+
+	for (unsigned i = 0; i < amount; ++i){
+		GLfloat* particle = &staging[i * particle_floats];
+		particle[0] = pos.x;
+		particle[1] = pos.y;
+		particle[2] = velocity.x + jitter(random);
+		particle[3] = velocity.y + jitter(random);
+		particle[4] = lifetime(random);
+	}
+
+	//Ring buffer, a burst that runs off the end wraps to the start
+	std::size_t first = next;
+	std::size_t head = std::min<std::size_t>(amount, capacity - first);
+
+	if (backend == PARTICLES_GPU){
+		uploadGpu(first, 0, head);
+		if (head < amount)
+			uploadGpu(0, head, amount - head);
+	}
+	else {
+		for (unsigned i = 0; i < amount; ++i){
+			const GLfloat* particle = &staging[i * particle_floats];
+			std::size_t slot = (first + i) % capacity;
+			particles.x[slot] = particle[0];
+			particles.y[slot] = particle[1];
+			particles.vx[slot] = particle[2];
+			particles.vy[slot] = particle[3];
+			particles.life[slot] = particle[4];
+		}
+	}
+
+	next = (first + amount) % capacity;
+	count = std::min(capacity, count + amount);
+}
+
+void ParticleSystem::uploadGpu(std::size_t slot, std::size_t first, std::size_t amount){
+	glBindBuffer(GL_ARRAY_BUFFER, gpuBuffer[current].get());
+	glBufferSubData(GL_ARRAY_BUFFER, slot * particle_stride,
+		amount * particle_stride, &staging[first * particle_floats]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleSystem::update(float deltaTime){
+	if (count == 0)
+		return;
+
+	if (backend == PARTICLES_CPU){
+		updateParticlesSimd(particles, count, deltaTime);
+		return;
+	}
+
+	//Read from current, capture into the other buffer, then swap
+	int target = 1 - current;
+
+	glUseProgram(updateProgram.get());
+	glUniform1f(deltaTimePos, deltaTime);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(updateVAO[current].get());
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, gpuBuffer[target].get());
+
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+	glEndTransformFeedback();
+
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	current = target;
+}
+
+void ParticleSystem::draw(){
+	if (count == 0)
+		return;
+
+	if (backend == PARTICLES_CPU){
+		GLsizeiptr block = capacity * sizeof(GLfloat);
+		GLsizeiptr used = count * sizeof(GLfloat);
+
+		glBindBuffer(GL_ARRAY_BUFFER, cpuBuffer.get());
+		glBufferSubData(GL_ARRAY_BUFFER, 0, used, particles.x.data());
+		glBufferSubData(GL_ARRAY_BUFFER, block, used, particles.y.data());
+		glBufferSubData(GL_ARRAY_BUFFER, 2 * block, used, particles.life.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glBindVertexArray(cpuVAO.get());
+	}
+	else {
+		glBindVertexArray(renderVAO[current].get());
+	}
+
+	glUseProgram(renderProgram.get());
+	glUniform4f(particleColorPos, 1.0f, 0.8f, 0.3f, 0.6f);
+
+	//Additive so overlapping particles glow instead of sorting
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+	glDisable(GL_BLEND);
+
+	glBindVertexArray(0);
+}
+
+void ParticleSystem::finish(){
+	if (backend == PARTICLES_GPU)
+		glFinish();
+}
+
+
+void benchmarkParticles(std::size_t count, int frames){
+	const float deltaTime = 1.0f / 60.0f;
+
+	auto report = [&](const char* name, double milliseconds){
+		double per_ms = double(count) * frames / milliseconds;
+		printf("%-24s %10.0f particles/ms  (%zu particles, %d frames, %.2f ms)\n",
+			name, per_ms, count, frames, milliseconds);
+	};
+
+	auto elapsed = [](std::chrono::steady_clock::time_point start){
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	ParticleArrays arrays;
+	arrays.resize(count);
+	for (std::size_t i = 0; i < count; ++i){
+		arrays.vx[i] = float(i % 200) / 100.0f - 1.0f;
+		arrays.vy[i] = float(i % 150) / 75.0f - 1.0f;
+		arrays.life[i] = 1000.0f;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; ++frame)
+		updateParticlesScalar(arrays, count, deltaTime);
+	report("CPU scalar", elapsed(start));
+
+	start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; ++frame)
+		updateParticlesSimd(arrays, count, deltaTime);
+	report("CPU SIMD", elapsed(start));
+
+	ParticleSystem gpu(PARTICLES_GPU, count);
+	gpu.emit(glm::vec2(0.0f, 0.0f), glm::vec2(0.0f, 0.0f), 1.0f, 1000.0f, (unsigned)count);
+	gpu.update(deltaTime);
+	gpu.finish();
+
+	start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; ++frame)
+		gpu.update(deltaTime);
+	gpu.finish();
+	report("GPU transform feedback", elapsed(start));
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "Resources.h"
+
+/*
+Description
+
+Particle effects for ball impacts and trails
+
+Particles bounce around the same -1..1 box as the ball in getBallVelocity.
+The GPU backend ping-pongs two vertex buffers through transform feedback,
+the CPU backend runs an SSE2 kernel over structure of arrays storage so the
+effect still works on llvmpipe or without a usable GPU.
+
+Both backends use a ring buffer, new bursts overwrite the oldest particles.
+
+*/
+
+const std::size_t particle_capacity = 1 << 20;
+
+enum ParticleBackend { PARTICLES_GPU, PARTICLES_CPU };
+
+//Structure of arrays storage for the CPU backend
+struct ParticleArrays {
+	void resize(std::size_t capacity);
+
+	std::vector<float> x, y;
+	std::vector<float> vx, vy;
+	std::vector<float> life;
+};
+
+//Bounce and integrate count particles, same rules as the GPU update shader
+void updateParticlesScalar(ParticleArrays& particles, std::size_t count, float deltaTime);
+void updateParticlesSimd(ParticleArrays& particles, std::size_t count, float deltaTime);
+
+//Transform feedback is slower than the SIMD kernel on software rasterizers
+ParticleBackend chooseParticleBackend();
+
+
+class ParticleSystem {
+public:
+	explicit ParticleSystem(ParticleBackend backend, std::size_t capacity = particle_capacity);
+
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	//Emits count particles at pos, velocity jittered by up to spread
+	void emit(glm::vec2 pos, glm::vec2 velocity, float spread, float life, unsigned count);
+	void update(float deltaTime);
+	void draw();
+
+	std::size_t size() const { return count; }
+	std::size_t getCapacity() const { return capacity; }
+	ParticleBackend getBackend() const { return backend; }
+
+	//Makes the GPU results visible so update can be timed
+	void finish();
+
+private:
+	void createRenderProgram();
+	void createGpuBuffers();
+	void createCpuBuffers();
+	void uploadGpu(std::size_t slot, std::size_t first, std::size_t amount);
+
+	ParticleBackend backend;
+	std::size_t capacity;
+	std::size_t count = 0;
+	std::size_t next = 0;
+
+	std::minstd_rand random;
+
+	//Staging for new particles, interleaved position, velocity, life
+	std::vector<GLfloat> staging;
+
+	//CPU backend
+	ParticleArrays particles;
+	HostMemory particles_memory{ "particle arrays" };
+	BufferHandle cpuBuffer;
+	VertexArrayHandle cpuVAO;
+
+	//GPU backend, index current is the buffer holding the latest state
+	BufferHandle gpuBuffer[2];
+	VertexArrayHandle updateVAO[2];
+	VertexArrayHandle renderVAO[2];
+	ProgramHandle updateProgram;
+	GLint deltaTimePos = -1;
+	int current = 0;
+
+	ProgramHandle renderProgram;
+	GLint particleColorPos = -1;
+};
+
+//Prints particles per millisecond for every backend available
+void benchmarkParticles(std::size_t count, int frames);
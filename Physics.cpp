@@ -0,0 +1,366 @@
+#include "Physics.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+static float millisecondsSince(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Enough tasks to keep the pool busy without making each one tiny
+static std::size_t taskCount(const WorkerPool& pool, std::size_t items, std::size_t min_items){
+	return std::max<std::size_t>(1, std::min<std::size_t>(pool.size() * 4, items / min_items));
+}
+
+
+PhysicsWorld::PhysicsWorld(WorkerPool& pool) :
+	pool(pool), bodies_memory("physics bodies"), contacts_memory("physics contacts") {
+}
+
+void PhysicsWorld::reserve(std::size_t bodies){
+	positions.reserve(bodies);
+	half_sizes.reserve(bodies);
+	velocities.reserve(bodies);
+	position_velocities.reserve(bodies);
+	inverse_masses.reserve(bodies);
+	materials.reserve(bodies);
+}
+
+std::uint32_t PhysicsWorld::addBody(glm::vec2 pos, glm::vec2 half_size, glm::vec2 velocity, float inverse_mass,
+	const PhysicsMaterial& material){
+	positions.push_back(pos);
+	half_sizes.push_back(half_size);
+	velocities.push_back(inverse_mass > 0.0f ? velocity : glm::vec2(0.0f, 0.0f));
+	position_velocities.push_back(glm::vec2(0.0f, 0.0f));
+	inverse_masses.push_back(inverse_mass);
+	materials.push_back(material);
+
+	bodies_memory.setBytes(positions.capacity() * (sizeof(glm::vec2) * 4 + sizeof(float) + sizeof(PhysicsMaterial)));
+	return std::uint32_t(positions.size() - 1);
+}
+
+std::uint32_t PhysicsWorld::addSprite(const Sprite& sprite, float inverse_mass){
+	return addBody(sprite.pos, sprite.size, sprite.velocity, inverse_mass, sprite.material);
+}
+
+void PhysicsWorld::copyToSprite(std::uint32_t body, Sprite& sprite) const {
+	sprite.velocity = velocities[body];
+	sprite.setPos(positions[body].x, positions[body].y);
+}
+
+
+void PhysicsWorld::step(float delta_time){
+	auto start = std::chrono::steady_clock::now();
+	const std::size_t count = size();
+
+	for (std::size_t i = 0; i < count; ++i)
+		if (inverse_masses[i] > 0.0f)
+			velocities[i] += settings.gravity * delta_time;
+
+	findContacts(delta_time);
+	buildBatches();
+	stats.broadphase_ms = millisecondsSince(start);
+	start = std::chrono::steady_clock::now();
+
+	solveBatches(&PhysicsWorld::warmStart);
+	for (unsigned iteration = 0; iteration < settings.iterations; ++iteration)
+		solveBatches(&PhysicsWorld::solveContact);
+	storeImpulses();
+
+	std::size_t tasks = taskCount(pool, count, 4096);
+	pool.run(tasks, [&](std::size_t task){
+		std::size_t first = count * task / tasks, last = count * (task + 1) / tasks;
+		for (std::size_t i = first; i < last; ++i){
+			if (inverse_masses[i] > 0.0f)
+				positions[i] += (velocities[i] + position_velocities[i]) * delta_time;
+			position_velocities[i] = glm::vec2(0.0f, 0.0f);
+		}
+	});
+
+	stats.bodies = count;
+	stats.contacts = contacts.size();
+	stats.solve_ms = millisecondsSince(start);
+}
+
+void PhysicsWorld::solveBatches(void (PhysicsWorld::*solve)(Contact&)){
+	for (unsigned batch = 0; batch <= physics_max_batches; ++batch){
+		std::uint32_t begin = batch_starts[batch], end = batch_starts[batch + 1];
+		if (begin == end)
+			continue;
+
+		//The last batch may share bodies between contacts, it stays on one thread
+		std::size_t tasks = batch == physics_max_batches ? 1 : taskCount(pool, end - begin, 256);
+		pool.run(tasks, [&](std::size_t task){
+			std::uint32_t first = std::uint32_t(begin + (end - begin) * task / tasks);
+			std::uint32_t last = std::uint32_t(begin + (end - begin) * (task + 1) / tasks);
+			for (std::uint32_t c = first; c < last; ++c)
+				(this->*solve)(contacts[c]);
+		});
+	}
+}
+
+void PhysicsWorld::findContacts(float delta_time){
+	const std::size_t count = size();
+
+	//Cells are as wide as the largest dynamic body so overlapping bodies are at most one cell apart
+	float max_half = 0.0f;
+	for (std::size_t i = 0; i < count; ++i)
+		if (inverse_masses[i] > 0.0f)
+			max_half = std::max(max_half, std::max(half_sizes[i].x, half_sizes[i].y));
+
+	//Anything bigger is static, so large bodies never need testing against each other
+	large_bodies.clear();
+	body_cells.assign(count, UINT32_MAX);
+	glm::vec2 low(FLT_MAX, FLT_MAX), high(-FLT_MAX, -FLT_MAX);
+	for (std::size_t i = 0; i < count; ++i){
+		if (half_sizes[i].x > max_half || half_sizes[i].y > max_half){
+			large_bodies.push_back(std::uint32_t(i));
+			continue;
+		}
+		low = glm::vec2(std::min(low.x, positions[i].x), std::min(low.y, positions[i].y));
+		high = glm::vec2(std::max(high.x, positions[i].x), std::max(high.y, positions[i].y));
+	}
+
+	std::size_t grid_x = 1, grid_y = 1;
+	float cell_size = 2.0f * max_half;
+	if (large_bodies.size() < count && cell_size > 0.0f){
+		//A sparse world would need more cells than bodies, grow the cells instead
+		glm::vec2 extent = high - low;
+		double cells = (double(extent.x / cell_size) + 1.0) * (double(extent.y / cell_size) + 1.0);
+		double max_cells = 4.0 * count + 64.0;
+		if (cells > max_cells)
+			cell_size *= float(std::sqrt(cells / max_cells)) * 1.01f;
+		grid_x = std::size_t(extent.x / cell_size) + 1;
+		grid_y = std::size_t(extent.y / cell_size) + 1;
+	}
+	else
+		cell_size = 1.0f;
+
+	//Counting sort of the bodies by cell
+	cell_starts.assign(grid_x * grid_y + 1, 0);
+	for (std::size_t i = 0; i < count; ++i){
+		if (half_sizes[i].x > max_half || half_sizes[i].y > max_half)
+			continue;
+		std::size_t x = std::min(std::size_t((positions[i].x - low.x) / cell_size), grid_x - 1);
+		std::size_t y = std::min(std::size_t((positions[i].y - low.y) / cell_size), grid_y - 1);
+		body_cells[i] = std::uint32_t(y * grid_x + x);
+		++cell_starts[body_cells[i] + 1];
+	}
+	for (std::size_t cell = 0; cell < grid_x * grid_y; ++cell)
+		cell_starts[cell + 1] += cell_starts[cell];
+	cell_bodies.resize(count - large_bodies.size());
+	{
+		std::vector<std::uint32_t> fill(cell_starts.begin(), cell_starts.end() - 1);
+		for (std::size_t i = 0; i < count; ++i)
+			if (body_cells[i] != UINT32_MAX)
+				cell_bodies[fill[body_cells[i]]++] = std::uint32_t(i);
+	}
+
+	auto addContact = [&](std::vector<Contact>& out, std::uint32_t owner, std::uint32_t body1, std::uint32_t body2){
+		float inverse_mass = inverse_masses[body1] + inverse_masses[body2];
+		if (inverse_mass == 0.0f)
+			return;
+
+		//Boxes closer than the margin are a contact with negative penetration
+		ContactManifold manifold;
+		glm::vec2 margin(settings.margin * 0.5f, settings.margin * 0.5f);
+		if (!getContact(positions[body1], half_sizes[body1] + margin, positions[body2], half_sizes[body2] + margin, manifold))
+			return;
+		manifold.penetration -= settings.margin;
+
+		PhysicsMaterial material = combineMaterials(materials[body1], materials[body2]);
+		float normal_speed = glm::dot(velocities[body2] - velocities[body1], manifold.normal);
+
+		Contact contact;
+		contact.body1 = body1;
+		contact.body2 = body2;
+		contact.owner = owner;
+		contact.normal = manifold.normal;
+		contact.penetration = manifold.penetration;
+		contact.normal_mass = 1.0f / inverse_mass;
+		//A separated pair may close the gap this step but not more
+		if (manifold.penetration < 0.0f)
+			contact.bias = manifold.penetration / delta_time;
+		else
+			contact.bias = normal_speed < -settings.restitution_speed ? -material.restitution * normal_speed : 0.0f;
+		contact.position_bias = settings.baumgarte / delta_time * std::max(manifold.penetration - settings.slop, 0.0f);
+		contact.friction = material.friction;
+		contact.normal_impulse = 0.0f;
+		contact.tangent_impulse = 0.0f;
+		contact.position_impulse = 0.0f;
+
+		//Same pair and the same face as last step, start from the impulses it ended with
+		std::uint32_t other = owner == body1 ? body2 : body1;
+		if (owner + 1u < warm_starts.size()){
+			for (std::uint32_t k = warm_starts[owner]; k < warm_starts[owner + 1]; ++k){
+				const WarmImpulse& warm = warm_impulses[k];
+				if (warm.other == other && warm.normal == manifold.normal){
+					contact.normal_impulse = warm.normal_impulse;
+					contact.tangent_impulse = warm.tangent_impulse;
+					break;
+				}
+			}
+		}
+		out.push_back(contact);
+	};
+
+	//Each task owns a range of bodies and only emits pairs where it owns the lower index
+	std::size_t tasks = taskCount(pool, count, 2048);
+	task_contacts.resize(std::max(task_contacts.size(), tasks));
+	pool.run(tasks, [&](std::size_t task){
+		std::vector<Contact>& out = task_contacts[task];
+		out.clear();
+		std::size_t first = count * task / tasks, last = count * (task + 1) / tasks;
+		for (std::size_t i = first; i < last; ++i){
+			if (body_cells[i] == UINT32_MAX)
+				continue;
+			std::uint32_t body = std::uint32_t(i);
+			std::size_t cx = body_cells[i] % grid_x, cy = body_cells[i] / grid_x;
+
+			for (std::size_t y = cy ? cy - 1 : 0; y <= std::min(cy + 1, grid_y - 1); ++y){
+				for (std::size_t x = cx ? cx - 1 : 0; x <= std::min(cx + 1, grid_x - 1); ++x){
+					std::size_t cell = y * grid_x + x;
+					for (std::uint32_t j = cell_starts[cell]; j < cell_starts[cell + 1]; ++j)
+						if (cell_bodies[j] > body)
+							addContact(out, body, body, cell_bodies[j]);
+				}
+			}
+			for (std::uint32_t large : large_bodies)
+				addContact(out, body, large, body);
+		}
+	});
+
+	for (std::size_t task = tasks; task < task_contacts.size(); ++task)
+		task_contacts[task].clear();
+}
+
+void PhysicsWorld::buildBatches(){
+	//Greedy coloring, the first batch neither dynamic body is in yet.  Static
+	//bodies are only read by the solver so they can be in every batch.
+	body_colors.assign(size(), 0);
+	std::vector<std::uint32_t> batch_sizes(physics_max_batches + 1, 0);
+	contact_colors.clear();
+	for (const std::vector<Contact>& out : task_contacts){
+		for (const Contact& contact : out){
+			std::uint32_t used = 0;
+			if (inverse_masses[contact.body1] > 0.0f)
+				used |= body_colors[contact.body1];
+			if (inverse_masses[contact.body2] > 0.0f)
+				used |= body_colors[contact.body2];
+
+			unsigned color = 0;
+			while (color < physics_max_batches && (used >> color & 1u))
+				++color;
+			if (color < physics_max_batches){
+				body_colors[contact.body1] |= 1u << color;
+				body_colors[contact.body2] |= 1u << color;
+			}
+			contact_colors.push_back(std::uint8_t(color));
+			++batch_sizes[color];
+		}
+	}
+
+	batch_starts.assign(physics_max_batches + 2, 0);
+	for (unsigned batch = 0; batch <= physics_max_batches; ++batch)
+		batch_starts[batch + 1] = batch_starts[batch] + batch_sizes[batch];
+
+	contacts.resize(contact_colors.size());
+	contact_order.resize(contact_colors.size());
+	std::vector<std::uint32_t> fill(batch_starts.begin(), batch_starts.end() - 1);
+	std::size_t index = 0;
+	for (const std::vector<Contact>& out : task_contacts){
+		for (const Contact& contact : out){
+			contact_order[index] = fill[contact_colors[index]]++;
+			contacts[contact_order[index]] = contact;
+			++index;
+		}
+	}
+	contacts_memory.setBytes(contacts.capacity() * sizeof(Contact));
+
+	stats.batches = 0;
+	for (unsigned batch = 0; batch <= physics_max_batches; ++batch)
+		if (batch_sizes[batch])
+			++stats.batches;
+	stats.serial_contacts = batch_sizes[physics_max_batches];
+}
+
+void PhysicsWorld::warmStart(Contact& contact){
+	glm::vec2 tangent(-contact.normal.y, contact.normal.x);
+	glm::vec2 impulse = contact.normal * contact.normal_impulse + tangent * contact.tangent_impulse;
+	if (inverse_masses[contact.body1] > 0.0f)
+		velocities[contact.body1] -= impulse * inverse_masses[contact.body1];
+	if (inverse_masses[contact.body2] > 0.0f)
+		velocities[contact.body2] += impulse * inverse_masses[contact.body2];
+}
+
+void PhysicsWorld::solveContact(Contact& contact){
+	glm::vec2& velocity1 = velocities[contact.body1];
+	glm::vec2& velocity2 = velocities[contact.body2];
+	const float inverse_mass1 = inverse_masses[contact.body1];
+	const float inverse_mass2 = inverse_masses[contact.body2];
+
+	//Normal, the accumulated impulse may shrink but never pull
+	float normal_speed = glm::dot(velocity2 - velocity1, contact.normal);
+	float impulse = contact.normal_mass * (contact.bias - normal_speed);
+	float accumulated = std::max(contact.normal_impulse + impulse, 0.0f);
+	impulse = accumulated - contact.normal_impulse;
+	contact.normal_impulse = accumulated;
+
+	//Static bodies are shared between contacts of a batch, never write them
+	if (inverse_mass1 > 0.0f)
+		velocity1 -= contact.normal * (impulse * inverse_mass1);
+	if (inverse_mass2 > 0.0f)
+		velocity2 += contact.normal * (impulse * inverse_mass2);
+
+	//Friction, boxes do not rotate so the tangent mass is the normal mass
+	glm::vec2 tangent(-contact.normal.y, contact.normal.x);
+	float tangent_speed = glm::dot(velocity2 - velocity1, tangent);
+	float limit = contact.friction * contact.normal_impulse;
+	impulse = -contact.normal_mass * tangent_speed;
+	accumulated = std::min(std::max(contact.tangent_impulse + impulse, -limit), limit);
+	impulse = accumulated - contact.tangent_impulse;
+	contact.tangent_impulse = accumulated;
+
+	if (inverse_mass1 > 0.0f)
+		velocity1 -= tangent * (impulse * inverse_mass1);
+	if (inverse_mass2 > 0.0f)
+		velocity2 += tangent * (impulse * inverse_mass2);
+
+	//Penetration, same clamp on the pseudo velocities
+	if (contact.position_bias > 0.0f || contact.position_impulse > 0.0f){
+		glm::vec2& position_velocity1 = position_velocities[contact.body1];
+		glm::vec2& position_velocity2 = position_velocities[contact.body2];
+		float separating_speed = glm::dot(position_velocity2 - position_velocity1, contact.normal);
+		impulse = contact.normal_mass * (contact.position_bias - separating_speed);
+		accumulated = std::max(contact.position_impulse + impulse, 0.0f);
+		impulse = accumulated - contact.position_impulse;
+		contact.position_impulse = accumulated;
+
+		if (inverse_mass1 > 0.0f)
+			position_velocity1 -= contact.normal * (impulse * inverse_mass1);
+		if (inverse_mass2 > 0.0f)
+			position_velocity2 += contact.normal * (impulse * inverse_mass2);
+	}
+}
+
+void PhysicsWorld::storeImpulses(){
+	//Counting sort by owner, in broadphase order so lookups scan a few entries per body
+	warm_starts.assign(size() + 1, 0);
+	for (const Contact& contact : contacts)
+		++warm_starts[contact.owner + 1];
+	for (std::size_t body = 0; body < size(); ++body)
+		warm_starts[body + 1] += warm_starts[body];
+
+	warm_impulses.resize(contacts.size());
+	std::vector<std::uint32_t> fill(warm_starts.begin(), warm_starts.end() - 1);
+	for (std::uint32_t batched : contact_order){
+		const Contact& contact = contacts[batched];
+		WarmImpulse& warm = warm_impulses[fill[contact.owner]++];
+		warm.other = contact.owner == contact.body1 ? contact.body2 : contact.body1;
+		warm.normal = contact.normal;
+		warm.normal_impulse = contact.normal_impulse;
+		warm.tangent_impulse = contact.tangent_impulse;
+	}
+}
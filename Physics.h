@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Collision.h"
+#include "Resources.h"
+#include "Sprite.h"
+#include "WorkerPool.h"
+
+/*
+Description
+
+Batched rigid box solver for many axis aligned sprites
+
+Bodies are kept as arrays of position, half size, velocity, inverse mass and
+material.  A body with an inverse mass of 0 is static, walls and floors are
+static bodies.  The boxes never rotate, so an AABB contact manifold is just a
+normal and a depth and the impulses need no angular terms.
+
+Every step integrates gravity, finds contacts through a uniform grid sized
+to the largest dynamic body (bodies too big for a cell are tested against
+everything), then runs a fixed number of sequential impulse iterations over
+the contact array.  Restitution is a target separating speed and friction is
+clamped to the accumulated normal impulse.  Penetration is removed with split
+impulses, a Baumgarte bias solved on separate pseudo velocities that move the
+bodies this step and are then dropped, so pushing boxes apart never turns
+into kinetic energy.  The real impulses of a pair that is still touching with
+the same normal are applied again at the start of the next step, which is
+what lets tall stacks settle in a few iterations.
+
+To solve in parallel the contacts are colored into batches in which no
+dynamic body appears twice, each batch is split across the worker pool and
+the batches run in order.  Contacts that do not fit in a color are solved
+last on one thread.  The result does not depend on the number of threads.
+
+*/
+
+const unsigned physics_max_batches = 32; // colors before contacts spill into the serial batch
+
+struct PhysicsSettings {
+	glm::vec2 gravity{ 0.0f, 0.0f };
+	unsigned iterations = 8; // velocity iterations per step
+	float baumgarte = 0.2f; // fraction of the penetration removed per step
+	float slop = 0.005f; // penetration left alone so resting contacts do not jitter
+	float margin = 0.01f; // gap at which a contact is kept, so resting pairs keep their impulses
+	float restitution_speed = 0.5f; // approach speed below which contacts do not bounce
+};
+
+struct PhysicsStats {
+	std::size_t bodies = 0;
+	std::size_t contacts = 0; // last step
+	unsigned batches = 0; // including the serial one
+	std::size_t serial_contacts = 0;
+	float broadphase_ms = 0.0f;
+	float solve_ms = 0.0f;
+};
+
+
+//Keeps a reference to the pool, it has to outlive the world
+class PhysicsWorld {
+public:
+	explicit PhysicsWorld(WorkerPool& pool);
+
+	PhysicsWorld(const PhysicsWorld&) = delete;
+	PhysicsWorld& operator=(const PhysicsWorld&) = delete;
+
+	void reserve(std::size_t bodies);
+
+	//Returns the body index, 0 inverse_mass makes it static
+	std::uint32_t addBody(glm::vec2 pos, glm::vec2 half_size, glm::vec2 velocity, float inverse_mass,
+		const PhysicsMaterial& material = PhysicsMaterial());
+	std::uint32_t addSprite(const Sprite& sprite, float inverse_mass);
+
+	//Writes position and velocity back and rebuilds the sprite transform
+	void copyToSprite(std::uint32_t body, Sprite& sprite) const;
+
+	void step(float delta_time);
+
+	std::size_t size() const { return positions.size(); }
+	glm::vec2 getPosition(std::uint32_t body) const { return positions[body]; }
+	glm::vec2 getVelocity(std::uint32_t body) const { return velocities[body]; }
+	void setVelocity(std::uint32_t body, glm::vec2 velocity) { velocities[body] = velocity; }
+
+	PhysicsSettings& getSettings() { return settings; }
+	const PhysicsStats& getStats() const { return stats; }
+
+private:
+	struct Contact {
+		std::uint32_t body1, body2;
+		std::uint32_t owner; // the body whose broadphase task found it, the other one is body1 or body2
+		glm::vec2 normal; // from body1 to body2
+		float penetration;
+		float normal_mass; // 1 / (inverse_mass1 + inverse_mass2)
+		float bias; // target separating speed from restitution
+		float position_bias; // separating speed that removes the penetration
+		float friction;
+		float normal_impulse;
+		float tangent_impulse;
+		float position_impulse;
+	};
+
+	//Last step's impulses grouped by owner
+	struct WarmImpulse {
+		std::uint32_t other;
+		glm::vec2 normal;
+		float normal_impulse;
+		float tangent_impulse;
+	};
+
+	void findContacts(float delta_time);
+	void buildBatches();
+	void solveBatches(void (PhysicsWorld::*solve)(Contact&));
+	void warmStart(Contact& contact);
+	void solveContact(Contact& contact);
+	void storeImpulses();
+
+	WorkerPool& pool;
+	PhysicsSettings settings;
+
+	std::vector<glm::vec2> positions;
+	std::vector<glm::vec2> half_sizes;
+	std::vector<glm::vec2> velocities;
+	std::vector<glm::vec2> position_velocities; // split impulse pseudo velocities, zeroed each step
+	std::vector<float> inverse_masses;
+	std::vector<PhysicsMaterial> materials;
+	HostMemory bodies_memory;
+
+	//Grid built each step, bodies sorted by cell
+	std::vector<std::uint32_t> body_cells;
+	std::vector<std::uint32_t> cell_starts;
+	std::vector<std::uint32_t> cell_bodies;
+	std::vector<std::uint32_t> large_bodies;
+
+	std::vector<std::vector<Contact>> task_contacts; // one per broadphase task, merged in order
+	std::vector<Contact> contacts; // grouped by batch
+	std::vector<std::uint32_t> batch_starts;
+	std::vector<std::uint8_t> contact_colors; // batch of each contact in broadphase order
+	std::vector<std::uint32_t> contact_order; // batched index of each contact in broadphase order
+	std::vector<std::uint32_t> body_colors; // bit per batch the body is already in
+	HostMemory contacts_memory;
+
+	std::vector<std::uint32_t> warm_starts;
+	std::vector<WarmImpulse> warm_impulses;
+
+	PhysicsStats stats;
+};
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Resources.h"
+#include "Shader.h"
+
+/*
+Description
+
+Compile time pipeline descriptors
+
+A pipeline is described by its feature bits and the vertex layout it reads.
+The GLSL for each variant is assembled at compile time from shared snippets,
+so the color, texture and animation programs no longer carry near duplicate
+source and a variant never contains code for a feature it does not use.
+
+Animation frames are read from the FrameTable uniform block baked by Atlas.h
+instead of dividing the sheet into a grid in the vertex shader.
+
+Uniforms are tag types.  Their locations are looked up once at link time into
+a fixed slot table, and setting a uniform the variant does not declare is a
+compile error instead of a silent -1 location.
+
+*/
+
+enum PipelineFeature : unsigned {
+	FEATURE_COLOR = 1 << 0,
+	FEATURE_TEXTURE = 1 << 1,
+	FEATURE_ANIMATION = 1 << 2,
+};
+
+//Attribute locations shared by the generated GLSL and the vertex layouts
+enum AttributeLocation : GLuint {
+	ATTRIB_POSITION = 0,
+	ATTRIB_COLOR = 1,
+	ATTRIB_TEXTURE = 2,
+};
+
+
+//Fixed size shader text that can be concatenated in a constant expression
+template <std::size_t N>
+struct ShaderText {
+	constexpr ShaderText() : text{} {}
+	constexpr ShaderText(const char(&str)[N]) : text{} {
+		for (std::size_t i = 0; i < N; ++i)
+			text[i] = str[i];
+	}
+	const char* c_str() const { return text; }
+	static constexpr std::size_t size() { return N - 1; }
+
+	char text[N];
+};
+
+template <std::size_t A, std::size_t B>
+constexpr ShaderText<A + B - 1> operator+(const ShaderText<A>& lhs, const ShaderText<B>& rhs){
+	ShaderText<A + B - 1> result;
+	for (std::size_t i = 0; i < A - 1; ++i)
+		result.text[i] = lhs.text[i];
+	for (std::size_t i = 0; i < B; ++i)
+		result.text[A - 1 + i] = rhs.text[i];
+	return result;
+}
+
+template <std::size_t A, std::size_t B>
+constexpr ShaderText<A + B - 1> operator+(const ShaderText<A>& lhs, const char(&rhs)[B]){
+	return lhs + ShaderText<B>(rhs);
+}
+
+//Decimal digits of Value, so GLSL array sizes follow the C++ constants
+template <unsigned Value>
+constexpr auto shaderNumber(){
+	constexpr char digit[2] = { char('0' + Value % 10), '\0' };
+	if constexpr (Value < 10)
+		return ShaderText<2>(digit);
+	else
+		return shaderNumber<Value / 10>() + digit;
+}
+
+//Snippet that only exists in the variant when the feature is enabled
+template <bool Enabled, std::size_t N>
+constexpr auto snippet(const ShaderText<N>& text){
+	if constexpr (Enabled)
+		return text;
+	else
+		return ShaderText<1>();
+}
+
+template <bool Enabled, std::size_t N>
+constexpr auto snippet(const char(&str)[N]){
+	return snippet<Enabled>(ShaderText<N>(str));
+}
+
+
+struct VertexAttribute {
+	GLuint location;
+	GLint components;
+	GLsizei stride;
+	std::size_t offset;
+};
+
+//Structure of Arrays, 6 positions followed by 6 colors
+struct ColorVertexLayout {
+	static constexpr unsigned features = FEATURE_COLOR;
+	static constexpr std::array<VertexAttribute, 2> attributes{ {
+		{ ATTRIB_POSITION, 3, 0, 0 },
+		{ ATTRIB_COLOR, 3, 0, 18 * sizeof(GLfloat) },
+	} };
+};
+
+//Array of structures, position then texture coordinate
+struct TextureVertexLayout {
+	static constexpr unsigned features = FEATURE_TEXTURE;
+	static constexpr std::array<VertexAttribute, 2> attributes{ {
+		{ ATTRIB_POSITION, 3, 5 * sizeof(GLfloat), 0 },
+		{ ATTRIB_TEXTURE, 2, 5 * sizeof(GLfloat), 3 * sizeof(GLfloat) },
+	} };
+};
+
+//Array of structures, position, color then texture coordinate, tinted text glyphs
+struct TextVertexLayout {
+	static constexpr unsigned features = FEATURE_COLOR | FEATURE_TEXTURE;
+	static constexpr std::array<VertexAttribute, 3> attributes{ {
+		{ ATTRIB_POSITION, 3, 8 * sizeof(GLfloat), 0 },
+		{ ATTRIB_COLOR, 3, 8 * sizeof(GLfloat), 3 * sizeof(GLfloat) },
+		{ ATTRIB_TEXTURE, 2, 8 * sizeof(GLfloat), 6 * sizeof(GLfloat) },
+	} };
+};
+
+template <typename Layout>
+constexpr GLint layoutComponents(GLuint location){
+	for (const VertexAttribute& attribute : Layout::attributes)
+		if (attribute.location == location)
+			return attribute.components;
+	return 0;
+}
+
+
+//Uniform tags, slot indexes the per program location table
+struct WorldSpace {
+	typedef glm::mat4 type;
+	static constexpr const char* name = "world_space";
+	static constexpr unsigned features = 0;
+	static constexpr int slot = 0;
+};
+
+struct TextureSampler {
+	typedef GLint type;
+	static constexpr const char* name = "tex";
+	static constexpr unsigned features = FEATURE_TEXTURE;
+	static constexpr int slot = 1;
+};
+
+struct AnimationIndex {
+	typedef GLuint type;
+	static constexpr const char* name = "animation_index";
+	static constexpr unsigned features = FEATURE_ANIMATION;
+	static constexpr int slot = 2;
+};
+
+const int uniform_slots = 3;
+
+//Animation frames come from a std140 block, the GLSL arrays are declared with this size
+const unsigned frame_table_size = 64;
+const GLuint frame_table_binding = 0;
+
+inline void uploadUniform(GLint location, const glm::mat4& value){
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+inline void uploadUniform(GLint location, GLint value){
+	glUniform1i(location, value);
+}
+inline void uploadUniform(GLint location, GLuint value){
+	glUniform1ui(location, value);
+}
+
+
+template <unsigned Features, typename Layout>
+struct PipelineDesc {
+	typedef Layout layout;
+
+	static constexpr bool has_color = (Features & FEATURE_COLOR) != 0;
+	static constexpr bool has_texture = (Features & FEATURE_TEXTURE) != 0;
+	static constexpr bool has_animation = (Features & FEATURE_ANIMATION) != 0;
+
+	static_assert(!has_animation || has_texture, "animation samples a sprite sheet and needs FEATURE_TEXTURE");
+	static_assert(layoutComponents<Layout>(ATTRIB_POSITION) == 3, "vertex layout must provide a vec3 position");
+	static_assert(!has_color || layoutComponents<Layout>(ATTRIB_COLOR) == 3, "vertex layout must provide a vec3 color");
+	static_assert(!has_texture || layoutComponents<Layout>(ATTRIB_TEXTURE) == 2, "vertex layout must provide a vec2 texture coordinate");
+
+	template <typename Uniform>
+	static constexpr bool uses(){
+		return (Uniform::features & ~Features) == 0;
+	}
+
+	static constexpr auto vertexSource(){
+		return ShaderText("#version 330 core\n\n")
+			+ "layout(location = 0) in vec3 vertexPosition_modelspace;\n"
+			+ snippet<has_color>("layout(location = 1) in vec3 vertex_color;\n")
+			+ snippet<has_texture>("layout(location = 2) in vec2 texture_pos;\n")
+			+ "\nuniform mat4 world_space;\n"
+			+ snippet<has_animation>(ShaderText("uniform uint animation_index;\n"
+				"layout(std140) uniform FrameTable {\n"
+				"    vec4 frame_uv[") + shaderNumber<frame_table_size>() + "];\n"
+				"    vec4 frame_quad[" + shaderNumber<frame_table_size>() + "];\n"
+				"};\n")
+			+ "\n"
+			+ snippet<has_color>("smooth out vec4 color;\n")
+			+ snippet<has_texture>("smooth out vec2 texture_coord;\n")
+			+ "\nvoid main(){\n"
+			+ snippet<!has_animation>(
+				"    gl_Position = world_space * vec4(vertexPosition_modelspace, 1.0f);\n")
+			+ snippet<has_animation>(
+				"    vec4 quad = frame_quad[animation_index];\n"
+				"    vec4 uv = frame_uv[animation_index];\n"
+				"    gl_Position = world_space * vec4(vertexPosition_modelspace.xy * quad.zw + quad.xy,\n"
+				"                                     vertexPosition_modelspace.z, 1.0f);\n")
+			+ snippet<has_color>("    color = vec4(vertex_color, 1.0);\n")
+			+ snippet<has_texture && !has_animation>("    texture_coord = texture_pos;\n")
+			+ snippet<has_animation>("    texture_coord = uv.xy + texture_pos * uv.zw;\n")
+			+ "}\n";
+	}
+
+	static constexpr auto fragmentSource(){
+		return ShaderText("#version 330 core\n\n")
+			+ snippet<has_color>("smooth in vec4 color;\n")
+			+ snippet<has_texture>(
+				"smooth in vec2 texture_coord;\n"
+				"uniform sampler2D tex;\n")
+			+ "\nout vec4 output_color;\n"
+			"\nvoid main(void)\n"
+			"{\n"
+			+ snippet<has_color && !has_texture>("    output_color = color;\n")
+			+ snippet<has_color && has_texture>("    output_color = texture(tex, texture_coord) * color;\n")
+			+ snippet<!has_color && has_texture>("    output_color = texture(tex, texture_coord);\n")
+			+ snippet<has_animation>("    if (output_color.a < 0.5)\n        discard;\n")
+			+ "}\n";
+	}
+};
+
+
+template <typename Desc>
+class Program {
+public:
+	Program(){
+		locations.fill(-1);
+	}
+
+	//label names the variant in the resource registry
+	bool build(const char* label){
+		static constexpr auto vs_source = Desc::vertexSource();
+		static constexpr auto fs_source = Desc::fragmentSource();
+
+		id = ProgramHandle(glCreateProgram(), label);
+		GLuint vs = createShader(GL_VERTEX_SHADER, vs_source.c_str());
+		GLuint fs = createShader(GL_FRAGMENT_SHADER, fs_source.c_str());
+		glAttachShader(id.get(), vs);
+		glAttachShader(id.get(), fs);
+		glLinkProgram(id.get());
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+
+		GLint pass_fail;
+		glGetProgramiv(id.get(), GL_LINK_STATUS, &pass_fail);
+		if (pass_fail != GL_TRUE){
+			std::fprintf(stderr, "WARNING DID NOT LINK\n");
+			return false;
+		}
+
+		lookup<WorldSpace>();
+		lookup<TextureSampler>();
+		lookup<AnimationIndex>();
+
+		if (Desc::has_animation)
+			glUniformBlockBinding(id.get(), glGetUniformBlockIndex(id.get(), "FrameTable"), frame_table_binding);
+		return true;
+	}
+
+	void use() const {
+		glUseProgram(id.get());
+	}
+
+	template <typename Uniform>
+	void set(const typename Uniform::type& value) const {
+		static_assert(Desc::template uses<Uniform>(), "uniform is stripped from this pipeline variant");
+		uploadUniform(locations[Uniform::slot], value);
+	}
+
+	ProgramHandle id;
+
+private:
+	template <typename Uniform>
+	void lookup(){
+		if (Desc::template uses<Uniform>())
+			locations[Uniform::slot] = glGetUniformLocation(id.get(), Uniform::name);
+	}
+
+	std::array<GLint, uniform_slots> locations;
+};
+
+
+//Builds a VAO that reads buffer with the attribute layout of a pipeline
+template <typename Layout>
+VertexArrayHandle createVertexArray(const BufferHandle& buffer){
+	VertexArrayHandle vao = makeVertexArray("vertex array");
+	glBindVertexArray(vao.get());
+	glBindBuffer(GL_ARRAY_BUFFER, buffer.get());
+	for (const VertexAttribute& attribute : Layout::attributes){
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE,
+			attribute.stride, (void*)attribute.offset);
+	}
+	glBindVertexArray(0);
+	return vao;
+}
+
+//Element buffer for quads of 4 vertices, two triangles 0 1 2  2 3 0 each
+inline BufferHandle createQuadIndexBuffer(unsigned quads){
+	std::vector<GLushort> indices(std::size_t(quads) * 6);
+	for (unsigned quad = 0; quad < quads; ++quad){
+		GLushort base = GLushort(quad * 4);
+		GLushort* index = &indices[std::size_t(quad) * 6];
+		index[0] = base;
+		index[1] = GLushort(base + 1);
+		index[2] = GLushort(base + 2);
+		index[3] = GLushort(base + 2);
+		index[4] = GLushort(base + 3);
+		index[5] = base;
+	}
+
+	BufferHandle buffer = makeBuffer("quad indices");
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.get());
+	bufferData(buffer, GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	return buffer;
+}
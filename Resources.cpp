@@ -0,0 +1,205 @@
+#include "Resources.h"
+
+#include <algorithm>
+
+static const char* const category_names[resource_categories] = {
+	"buffers", "textures", "programs", "vertex arrays", "host memory"
+};
+
+static bool isVram(ResourceCategory category){
+	return category == RESOURCE_BUFFER || category == RESOURCE_TEXTURE;
+}
+
+static double megabytes(std::size_t bytes){
+	return bytes / (1024.0 * 1024.0);
+}
+
+
+ResourceRegistry& ResourceRegistry::get(){
+	static ResourceRegistry registry;
+	return registry;
+}
+
+std::uint32_t ResourceRegistry::add(ResourceCategory category, const char* label, GLuint id, std::size_t bytes){
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::uint32_t record;
+	if (free_records.empty()){
+		record = std::uint32_t(records.size());
+		records.push_back(Record());
+	}
+	else {
+		record = free_records.back();
+		free_records.pop_back();
+	}
+
+	Record& entry = records[record];
+	entry.category = category;
+	entry.label = label ? label : "";
+	entry.id = id;
+	entry.bytes = bytes;
+	entry.alive = true;
+	change(category, 1, std::ptrdiff_t(bytes));
+	return record;
+}
+
+void ResourceRegistry::resize(std::uint32_t record, std::size_t bytes){
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Record& resource = records[record];
+	change(resource.category, 0, std::ptrdiff_t(bytes) - std::ptrdiff_t(resource.bytes));
+	resource.bytes = bytes;
+}
+
+void ResourceRegistry::remove(std::uint32_t record){
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Record& resource = records[record];
+	change(resource.category, -1, -std::ptrdiff_t(resource.bytes));
+	resource.alive = false;
+	free_records.push_back(record);
+}
+
+void ResourceRegistry::change(ResourceCategory category, std::ptrdiff_t count, std::ptrdiff_t bytes){
+	ResourceUsage& used = usage[category];
+	used.count += count;
+	used.bytes += bytes;
+	used.peak_count = std::max(used.peak_count, used.count);
+	used.peak_bytes = std::max(used.peak_bytes, used.bytes);
+
+	if (isVram(category)){
+		vram += bytes;
+		peak_vram = std::max(peak_vram, vram);
+	}
+	else if (category == RESOURCE_HOST){
+		ram += bytes;
+		peak_ram = std::max(peak_ram, ram);
+	}
+	checkBudget();
+}
+
+void ResourceRegistry::checkBudget(){
+	//Warn once per crossing, not on every allocation while over
+	bool vram_over = vram_budget && vram > vram_budget;
+	if (vram_over && !vram_warned)
+		std::fprintf(stderr, "WARNING VRAM BUDGET EXCEEDED %.1f of %.1f MB\n", megabytes(vram), megabytes(vram_budget));
+	vram_warned = vram_over;
+
+	bool ram_over = ram_budget && ram > ram_budget;
+	if (ram_over && !ram_warned)
+		std::fprintf(stderr, "WARNING RAM BUDGET EXCEEDED %.1f of %.1f MB\n", megabytes(ram), megabytes(ram_budget));
+	ram_warned = ram_over;
+}
+
+ResourceUsage ResourceRegistry::getUsage(ResourceCategory category) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return usage[category];
+}
+
+std::size_t ResourceRegistry::getVramBytes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return vram;
+}
+
+std::size_t ResourceRegistry::getRamBytes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return ram;
+}
+
+std::size_t ResourceRegistry::getPeakVramBytes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return peak_vram;
+}
+
+std::size_t ResourceRegistry::getPeakRamBytes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return peak_ram;
+}
+
+void ResourceRegistry::setBudget(std::size_t vram_bytes, std::size_t ram_bytes){
+	std::lock_guard<std::mutex> lock(mutex);
+	vram_budget = vram_bytes;
+	ram_budget = ram_bytes;
+	vram_warned = ram_warned = false;
+	checkBudget();
+}
+
+bool ResourceRegistry::withinBudget() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return (!vram_budget || vram <= vram_budget) && (!ram_budget || ram <= ram_budget);
+}
+
+void ResourceRegistry::printUsage(std::FILE* out) const {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (int i = 0; i < resource_categories; ++i){
+		const ResourceUsage& used = usage[i];
+		std::fprintf(out, "%-14s %6zu live %8.2f MB, peak %6zu / %8.2f MB\n", category_names[i],
+			used.count, megabytes(used.bytes), used.peak_count, megabytes(used.peak_bytes));
+	}
+	std::fprintf(out, "VRAM %.2f MB, peak %.2f MB, budget %.0f MB\n",
+		megabytes(vram), megabytes(peak_vram), megabytes(vram_budget));
+	std::fprintf(out, "RAM  %.2f MB, peak %.2f MB, budget %.0f MB\n",
+		megabytes(ram), megabytes(peak_ram), megabytes(ram_budget));
+}
+
+std::size_t ResourceRegistry::reportLeaks(std::FILE* out) const {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::size_t leaks = 0;
+	for (const Record& resource : records){
+		if (!resource.alive)
+			continue;
+		std::fprintf(out, "LEAK %s %u \"%s\" %zu bytes\n", category_names[resource.category],
+			resource.id, resource.label.c_str(), resource.bytes);
+		++leaks;
+	}
+	return leaks;
+}
+
+
+BufferHandle makeBuffer(const char* label){
+	GLuint id;
+	glGenBuffers(1, &id);
+	return BufferHandle(id, label);
+}
+
+TextureHandle makeTexture(const char* label){
+	GLuint id;
+	glGenTextures(1, &id);
+	return TextureHandle(id, label);
+}
+
+VertexArrayHandle makeVertexArray(const char* label){
+	GLuint id;
+	glGenVertexArrays(1, &id);
+	return VertexArrayHandle(id, label);
+}
+
+void bufferData(BufferHandle& buffer, GLenum target, std::size_t size, const void* data, GLenum usage){
+	glBufferData(target, GLsizeiptr(size), data, usage);
+	buffer.setBytes(size);
+}
+
+std::size_t textureBytes(unsigned width, unsigned height, unsigned texel_bytes, unsigned max_level){
+	std::size_t bytes = 0;
+	for (unsigned level = 0; level <= max_level; ++level){
+		bytes += std::size_t(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * texel_bytes;
+		if ((width >> level) <= 1 && (height >> level) <= 1)
+			break;
+	}
+	return bytes;
+}
+
+
+HostMemory::HostMemory(const char* label, std::size_t bytes) :
+	record(ResourceRegistry::get().add(RESOURCE_HOST, label, 0, bytes)) {
+}
+
+HostMemory::~HostMemory(){
+	ResourceRegistry::get().remove(record);
+}
+
+void HostMemory::setBytes(std::size_t bytes){
+	ResourceRegistry::get().resize(record, bytes);
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+/*
+Description
+
+Owning handles for GL objects and the registry that accounts for them
+
+Every buffer, texture, program and vertex array is held by a move only
+handle that deletes the object when it goes out of scope.  Each handle has a
+record in the ResourceRegistry with a label and a byte size, so the registry
+knows the live count and bytes per category and the peaks of both.  Large
+CPU side arrays register a HostMemory record the same way.
+
+At shutdown every handle must be gone before the context is destroyed,
+reportLeaks lists whatever is left.  VRAM and RAM budgets are checked on
+every allocation and a warning is printed the first time one is exceeded.
+
+*/
+
+enum ResourceCategory {
+	RESOURCE_BUFFER,
+	RESOURCE_TEXTURE,
+	RESOURCE_PROGRAM,
+	RESOURCE_VERTEX_ARRAY,
+	RESOURCE_HOST, // CPU side memory, counts against the RAM budget
+};
+
+const int resource_categories = RESOURCE_HOST + 1;
+
+struct ResourceUsage {
+	std::size_t count = 0;
+	std::size_t bytes = 0;
+	std::size_t peak_count = 0;
+	std::size_t peak_bytes = 0;
+};
+
+class ResourceRegistry {
+public:
+	static ResourceRegistry& get();
+
+	//Returns the record the handle keeps
+	std::uint32_t add(ResourceCategory category, const char* label, GLuint id, std::size_t bytes);
+	void resize(std::uint32_t record, std::size_t bytes);
+	void remove(std::uint32_t record);
+
+	ResourceUsage getUsage(ResourceCategory category) const;
+
+	//Buffers and textures count as VRAM, host records as RAM
+	std::size_t getVramBytes() const;
+	std::size_t getRamBytes() const;
+	std::size_t getPeakVramBytes() const;
+	std::size_t getPeakRamBytes() const;
+
+	//0 means no budget
+	void setBudget(std::size_t vram_bytes, std::size_t ram_bytes);
+	bool withinBudget() const;
+
+	void printUsage(std::FILE* out) const;
+
+	//Prints every live record, returns how many there are
+	std::size_t reportLeaks(std::FILE* out) const;
+
+private:
+	struct Record {
+		ResourceCategory category;
+		std::string label; // copied, the caller's string may be temporary
+		GLuint id;
+		std::size_t bytes;
+		bool alive;
+	};
+
+	ResourceRegistry() {}
+	void change(ResourceCategory category, std::ptrdiff_t count, std::ptrdiff_t bytes);
+	void checkBudget();
+
+	mutable std::mutex mutex;
+	std::vector<Record> records;
+	std::vector<std::uint32_t> free_records;
+	ResourceUsage usage[resource_categories];
+
+	std::size_t vram = 0, ram = 0;
+	std::size_t peak_vram = 0, peak_ram = 0;
+	std::size_t vram_budget = 0, ram_budget = 0;
+	bool vram_warned = false, ram_warned = false;
+};
+
+
+inline void deleteGLObject(ResourceCategory category, GLuint id){
+	switch (category){
+	case RESOURCE_BUFFER: glDeleteBuffers(1, &id); break;
+	case RESOURCE_TEXTURE: glDeleteTextures(1, &id); break;
+	case RESOURCE_PROGRAM: glDeleteProgram(id); break;
+	case RESOURCE_VERTEX_ARRAY: glDeleteVertexArrays(1, &id); break;
+	case RESOURCE_HOST: break;
+	}
+}
+
+template <ResourceCategory Category>
+class GLHandle {
+public:
+	GLHandle() {}
+	GLHandle(GLuint id, const char* label, std::size_t bytes = 0) : id(id) {
+		if (id)
+			record = ResourceRegistry::get().add(Category, label, id, bytes);
+	}
+	~GLHandle(){
+		reset();
+	}
+
+	GLHandle(const GLHandle&) = delete;
+	GLHandle& operator=(const GLHandle&) = delete;
+
+	GLHandle(GLHandle&& other) noexcept : id(other.id), record(other.record) {
+		other.id = 0;
+		other.record = UINT32_MAX;
+	}
+	GLHandle& operator=(GLHandle&& other) noexcept {
+		if (this != &other){
+			reset();
+			id = other.id;
+			record = other.record;
+			other.id = 0;
+			other.record = UINT32_MAX;
+		}
+		return *this;
+	}
+
+	GLuint get() const { return id; }
+	explicit operator bool() const { return id != 0; }
+
+	//Storage size after glBufferData or glTexImage2D
+	void setBytes(std::size_t bytes){
+		if (id)
+			ResourceRegistry::get().resize(record, bytes);
+	}
+
+	void reset(){
+		if (id){
+			deleteGLObject(Category, id);
+			ResourceRegistry::get().remove(record);
+		}
+		id = 0;
+		record = UINT32_MAX;
+	}
+
+private:
+	GLuint id = 0;
+	std::uint32_t record = UINT32_MAX;
+};
+
+typedef GLHandle<RESOURCE_BUFFER> BufferHandle;
+typedef GLHandle<RESOURCE_TEXTURE> TextureHandle;
+typedef GLHandle<RESOURCE_PROGRAM> ProgramHandle;
+typedef GLHandle<RESOURCE_VERTEX_ARRAY> VertexArrayHandle;
+
+BufferHandle makeBuffer(const char* label);
+TextureHandle makeTexture(const char* label);
+VertexArrayHandle makeVertexArray(const char* label);
+
+//glBufferData on the buffer bound to target, records the new size
+void bufferData(BufferHandle& buffer, GLenum target, std::size_t size, const void* data, GLenum usage);
+
+//Bytes of a texture with levels 0..max_level
+std::size_t textureBytes(unsigned width, unsigned height, unsigned texel_bytes, unsigned max_level = 0);
+
+
+//Accounts a CPU side allocation against the RAM budget, the memory itself is owned elsewhere
+class HostMemory {
+public:
+	explicit HostMemory(const char* label, std::size_t bytes = 0);
+	~HostMemory();
+
+	HostMemory(const HostMemory&) = delete;
+	HostMemory& operator=(const HostMemory&) = delete;
+
+	void setBytes(std::size_t bytes);
+
+private:
+	std::uint32_t record;
+};
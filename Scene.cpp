@@ -0,0 +1,271 @@
+#include "Scene.h"
+
+#include <iostream>
+#include <memory>
+
+#include <glm/gtx/transform.hpp>
+
+#include "Atlas.h"
+#include "Bitmap.h"
+#include "Collision.h"
+
+using std::cout;
+using std::endl;
+
+
+bool createSceneResources(SceneResources& scene){
+
+	bool linked = scene.program.build("color program");
+	linked = scene.program_texture.build("texture program") && linked;
+	linked = scene.program_animation.build("animation program") && linked;
+
+	//Structure of Arrays  Triangles then Colors
+	static const GLfloat g_vertex_buffer_data[] = {
+		//First Triangle
+		-1.0f, -1.0f, 0.0f,
+		-1.0f, 1.0f, 0.0f,
+		1.0f, -1.0f, 0.0f,
+
+		//Second Triangle
+		1.0f, 1.0f, 0.0f,
+		1.0f, -1.0f, 0.0f,
+		-1.0f, 1.0f, 0.0f,
+
+		//First Color
+		1.0f, 1.0f, 0.0f,
+		1.0f, 1.0f, 0.0f,
+		1.0f, 1.0f, 0.0f,
+
+
+		//Second Color
+		0.0f, 1.0f, 1.0f,
+		0.0f, 1.0f, 1.0f,
+		0.0f, 1.0f, 1.0f,
+	};
+
+
+	//Array of structures, interlace triangles, color, and texture coordinates
+	//To do, use an element buffer
+	static const GLfloat g_vertex_buffer_data_texture[] = {
+		//First Triangle      //Coordinates
+		-1.0f, -1.0f, 0.0f,   0.0f , 0.0f,
+		-1.0f, 1.0f, 0.0f,    0.0f , 1.0f,
+		1.0f, -1.0f, 0.0f,    1.0f , 0.0f,
+
+		//Second Triangle
+		1.0f, 1.0f, 0.0f,    1.0f , 1.0f ,
+		1.0f, -1.0f, 0.0f,   1.0f , 0.0f ,
+		-1.0f, 1.0f, 0.0f,   0.0f , 1.0f ,
+
+	};
+
+
+	scene.vertexbuffer = makeBuffer("color quad");
+	glBindBuffer(GL_ARRAY_BUFFER, scene.vertexbuffer.get());
+	bufferData(scene.vertexbuffer, GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
+
+	scene.vertexbufferTexture = makeBuffer("texture quad");
+	glBindBuffer(GL_ARRAY_BUFFER, scene.vertexbufferTexture.get());
+	bufferData(scene.vertexbufferTexture, GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data_texture), g_vertex_buffer_data_texture, GL_STATIC_DRAW);
+
+	unsigned int height{0}, width{0};
+	std::unique_ptr<unsigned char[]> data ( load_bmp("Title.bmp" , width , height ) );
+	if (!data)
+		return false;
+
+	scene.titleID = createBmpTexture(data.get(), width, height, "title");
+
+
+	//Baked by AtlasBaker, or sliced from the sheet at startup when there is no baked file
+	Atlas mario_atlas;
+	if (!loadAtlas("Mario.atlas", mario_atlas)){
+		data.reset( load_bmp("Mario.bmp", width, height));
+		//colums then rows
+		if (!bakeAtlas(data.get(), width, height, 10, 5, mario_atlas))
+			return false;
+	}
+	scene.marioID = createAtlasTexture(mario_atlas);
+	scene.frameTableID = createFrameTable(mario_atlas);
+	scene.frameCount = GLuint(mario_atlas.frames.size());
+
+	//The context binds the frame table, so it has to exist first
+	createSceneContext(scene, scene.context);
+
+
+	//Both textured programs sample unit 0
+	scene.program_texture.use();
+	scene.program_texture.set<TextureSampler>(0);
+	scene.program_animation.use();
+	scene.program_animation.set<TextureSampler>(0);
+
+	return linked;
+}
+
+
+void initSceneSprites(SceneSprites& sprites){
+	sprites.paddle1.setPos(-0.55f, 0.55f);
+	sprites.paddle2.setPos(0.55f, 0.55f);
+	sprites.ball.setPos(0.0f, 0.55f);
+
+	sprites.paddle1.setSize(paddle_size, paddle_size);
+	sprites.paddle2.setSize(paddle_size, paddle_size);
+	sprites.ball.setSize(ball_size, ball_size);
+
+	sprites.ball.setVelocity(1.0f * ball_speed, 0.0f);
+
+	sprites.paddle1.material = paddle_material;
+	sprites.paddle2.material = paddle_material;
+	sprites.ball.material = ball_material;
+
+	sprites.title.setPos(-0.55f, -0.55f);
+	sprites.title.setSize(0.15f, 0.15f);
+
+	sprites.mario.setPos(0.55f, -0.55f);
+	sprites.mario.setSize(0.15f, 0.15f);
+
+	sprites.animationIndex = 0;
+}
+
+
+glm::mat4 Camera2D::getViewTransform() const {
+	return glm::scale(glm::vec3(1.0f / half_extent, 1.0f)) * glm::translate(glm::vec3(-center, 0.0f));
+}
+
+bool Camera2D::overlaps(glm::vec2 pos, glm::vec2 size) const {
+	glm::vec2 distance = glm::abs(pos - center);
+	return distance.x <= half_extent.x + size.x && distance.y <= half_extent.y + size.y;
+}
+
+
+void createSceneContext(const SceneResources& scene, SceneContext& context){
+	//One VAO per vertex layout, the attribute pointers come from the pipeline descriptors
+	context.colorVAO = createVertexArray<ColorVertexLayout>(scene.vertexbuffer);
+	context.textureVAO = createVertexArray<TextureVertexLayout>(scene.vertexbufferTexture);
+
+	//Indexed binding points are context state too
+	glBindBufferBase(GL_UNIFORM_BUFFER, frame_table_binding, scene.frameTableID.get());
+}
+
+void CommandList::clear(){
+	commands.clear();
+	order.clear();
+	state_changes = 0;
+}
+
+void CommandList::add(SortKey key, const DrawCommand& command){
+	order.push_back({ key, std::uint32_t(commands.size()) });
+	commands.push_back(command);
+}
+
+void CommandList::sort(WorkerPool* pool){
+	sortEntries(order, scratch, pool);
+	state_changes = countStateChanges(order.data(), order.size());
+}
+
+
+static void addSprite(CommandList& commands, const glm::mat4& view, const Camera2D& camera, const Sprite& sprite,
+	SceneLayer layer, BlendMode blend, SceneProgram program, SceneTexture texture, GLuint animation_index = 0){
+	if (camera.overlaps(sprite.pos, sprite.size))
+		commands.add(makeSortKey(layer, blend, program, texture, sprite.depth),
+			{ view * sprite.getWorldTransform(), animation_index });
+}
+
+void prepareScene(const SceneSprites* sprites, std::size_t count, const Camera2D& camera, CommandList& commands){
+	const glm::mat4 view = camera.getViewTransform();
+
+	for (std::size_t i = 0; i < count; ++i){
+		const SceneSprites& scene = sprites[i];
+		addSprite(commands, view, camera, scene.paddle1, SCENE_LAYER_GAME, BLEND_OPAQUE, SCENE_PROGRAM_COLOR, SCENE_TEXTURE_NONE);
+		addSprite(commands, view, camera, scene.paddle2, SCENE_LAYER_GAME, BLEND_OPAQUE, SCENE_PROGRAM_COLOR, SCENE_TEXTURE_NONE);
+		addSprite(commands, view, camera, scene.ball, SCENE_LAYER_GAME, BLEND_OPAQUE, SCENE_PROGRAM_COLOR, SCENE_TEXTURE_NONE);
+		addSprite(commands, view, camera, scene.title, SCENE_LAYER_BACKGROUND, BLEND_OPAQUE, SCENE_PROGRAM_TEXTURE, SCENE_TEXTURE_TITLE);
+		addSprite(commands, view, camera, scene.mario, SCENE_LAYER_GAME, BLEND_ALPHA, SCENE_PROGRAM_ANIMATION, SCENE_TEXTURE_MARIO,
+			scene.animationIndex);
+	}
+}
+
+static void setBlend(BlendMode blend){
+	switch (blend){
+	case BLEND_OPAQUE:
+		glDisable(GL_BLEND);
+		break;
+	case BLEND_ALPHA:
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		break;
+	case BLEND_ADDITIVE:
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+		break;
+	}
+}
+
+unsigned submitCommands(const SceneResources& scene, const SceneContext& context, const CommandList& commands){
+	const GLuint textures[] = { 0, scene.titleID.get(), scene.marioID.get() };
+
+	//Sorted by key, the state only changes between runs of equal blend, program and texture
+	int blend = -1, program = -1, texture = -1;
+	for (const SortEntry& entry : commands.order){
+		const DrawCommand& command = commands.commands[entry.index];
+
+		int next_blend = getKeyBlend(entry.key);
+		if (next_blend != blend){
+			blend = next_blend;
+			setBlend(BlendMode(blend));
+		}
+
+		int next_program = int(getKeyProgram(entry.key));
+		if (next_program != program){
+			program = next_program;
+			switch (program){
+			case SCENE_PROGRAM_COLOR:
+				scene.program.use();
+				glBindVertexArray(context.colorVAO.get());
+				break;
+			case SCENE_PROGRAM_TEXTURE:
+				scene.program_texture.use();
+				glBindVertexArray(context.textureVAO.get());
+				break;
+			case SCENE_PROGRAM_ANIMATION:
+				scene.program_animation.use();
+				glBindVertexArray(context.textureVAO.get());
+				break;
+			}
+		}
+
+		int next_texture = int(getKeyTexture(entry.key));
+		if (next_texture != texture){
+			texture = next_texture;
+			if (texture != SCENE_TEXTURE_NONE)
+				glBindTexture(GL_TEXTURE_2D, textures[texture]);
+		}
+
+		switch (program){
+		case SCENE_PROGRAM_COLOR:
+			scene.program.set<WorldSpace>(command.world_space);
+			break;
+		case SCENE_PROGRAM_TEXTURE:
+			scene.program_texture.set<WorldSpace>(command.world_space);
+			break;
+		case SCENE_PROGRAM_ANIMATION:
+			scene.program_animation.set<WorldSpace>(command.world_space);
+			scene.program_animation.set<AnimationIndex>(command.animation_index);
+			break;
+		}
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	}
+
+	if (blend > BLEND_OPAQUE)
+		glDisable(GL_BLEND);
+	glBindVertexArray(0);
+	return unsigned(commands.size());
+}
+
+unsigned drawScene(const SceneResources& scene, const SceneSprites* sprites, std::size_t count){
+	CommandList commands;
+	commands.commands.reserve(count * 5);
+	commands.order.reserve(count * 5);
+	prepareScene(sprites, count, Camera2D(), commands);
+	commands.sort();
+	return submitCommands(scene, scene.context, commands);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "DrawSort.h"
+#include "Pipeline.h"
+#include "Sprite.h"
+#include "WorkerPool.h"
+
+/*
+Description
+
+The demo scene, two paddles and a ball, the title and the animated mario
+
+SceneResources owns the GL objects every copy of the scene shares, they are
+released when it is destroyed.
+drawScene takes an array of scenes and draws them grouped by program, the
+game draws one and the headless benchmark scales the same path up to N.
+
+Drawing is split in two so several views can share the work.  prepareScene
+only touches sprites and fills a command list for one camera, it is safe to
+run on any thread.  submitCommands issues the GL calls and must run on the
+thread whose context is current, with the SceneContext made for that context
+since vertex arrays are not shared between contexts.
+
+Every command carries a sort key, see DrawSort.h.  The list is sorted before
+it is submitted and submitCommands only changes blend, program or texture
+when the key says so, the mario sheet is alpha blended back to front.
+
+*/
+
+typedef PipelineDesc<FEATURE_COLOR, ColorVertexLayout> ColorPipeline;
+typedef PipelineDesc<FEATURE_TEXTURE, TextureVertexLayout> TexturePipeline;
+typedef PipelineDesc<FEATURE_TEXTURE | FEATURE_ANIMATION, TextureVertexLayout> AnimationPipeline;
+
+//Looks at a rectangle of the world, also the tile map camera
+struct Camera2D {
+	glm::vec2 center{ 0.0f, 0.0f };
+	glm::vec2 half_extent{ 1.0f, 1.0f }; // from the center to the edge of the viewport
+
+	glm::mat4 getViewTransform() const;
+	bool overlaps(glm::vec2 pos, glm::vec2 size) const;
+};
+
+//Per context objects, has to be destroyed with its context current
+struct SceneContext {
+	VertexArrayHandle colorVAO;
+	VertexArrayHandle textureVAO;
+};
+
+struct SceneResources {
+	Program<ColorPipeline> program;
+	Program<TexturePipeline> program_texture;
+	Program<AnimationPipeline> program_animation;
+
+	BufferHandle vertexbuffer;
+	BufferHandle vertexbufferTexture;
+
+	TextureHandle titleID;
+	TextureHandle marioID;
+	BufferHandle frameTableID;
+	GLuint frameCount = 0;
+
+	SceneContext context; // for the context the scene was created in
+};
+
+struct SceneSprites {
+	Sprite paddle1, paddle2, ball;
+	Sprite title, mario;
+	GLuint animationIndex = 0;
+};
+
+//Builds the programs, quads and textures, needs a current GL 3.3 context
+bool createSceneResources(SceneResources& scene);
+
+//Start positions of the demo
+void initSceneSprites(SceneSprites& sprites);
+
+//Vertex arrays and the frame table binding for the current context, the scene
+//may have been created in another context of the same share group
+void createSceneContext(const SceneResources& scene, SceneContext& context);
+
+//Key fields, the program decides the vertex array and the uniforms
+enum SceneLayer { SCENE_LAYER_BACKGROUND, SCENE_LAYER_GAME };
+enum SceneProgram { SCENE_PROGRAM_COLOR, SCENE_PROGRAM_TEXTURE, SCENE_PROGRAM_ANIMATION };
+enum SceneTexture { SCENE_TEXTURE_NONE, SCENE_TEXTURE_TITLE, SCENE_TEXTURE_MARIO };
+
+struct DrawCommand {
+	glm::mat4 world_space;
+	GLuint animation_index;
+};
+
+//Commands in the order they were added and the order they are drawn in
+struct CommandList {
+	std::vector<DrawCommand> commands;
+	std::vector<SortEntry> order; // keys with an index into commands
+	std::vector<SortEntry> scratch;
+	unsigned state_changes = 0; // in order, counted by sort
+
+	void clear();
+	void add(SortKey key, const DrawCommand& command);
+	void sort(WorkerPool* pool = nullptr);
+	std::size_t size() const { return commands.size(); }
+};
+
+//Appends the sprites the camera sees, unsorted
+void prepareScene(const SceneSprites* sprites, std::size_t count, const Camera2D& camera, CommandList& commands);
+
+//Draws in the sorted order, returns the number of draw calls
+unsigned submitCommands(const SceneResources& scene, const SceneContext& context, const CommandList& commands);
+
+//prepareScene with the default camera, sort, then submitCommands
+unsigned drawScene(const SceneResources& scene, const SceneSprites* sprites, std::size_t count);
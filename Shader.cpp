@@ -0,0 +1,41 @@
+#include "Shader.h"
+
+#include <cstdio>
+
+GLuint createShader(GLenum eShaderType, const std::string &strShaderFile)
+{
+	GLuint shader = glCreateShader(eShaderType);
+	const char *strFileData = strShaderFile.c_str();
+	glShaderSource(shader, 1, &strFileData, NULL);
+
+	glCompileShader(shader);
+
+	const char *strShaderType = NULL;
+	switch (eShaderType)
+	{
+		case GL_VERTEX_SHADER: strShaderType = "Vertex"; break;
+		case GL_GEOMETRY_SHADER: strShaderType = "Geometry"; break;
+		case GL_FRAGMENT_SHADER: strShaderType = "Fragment"; break;
+	}
+
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status == GL_FALSE)
+	{
+		GLint infoLogLength;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+		GLchar *strInfoLog = new GLchar[infoLogLength + 1];
+		glGetShaderInfoLog(shader, infoLogLength, NULL, strInfoLog);
+
+	
+
+		fprintf(stderr, "Compile failure in %s shader:\n%s\n", strShaderType, strInfoLog);
+		delete[] strInfoLog;
+	}
+	else {
+		fprintf(stderr, "%s Shader Compile Succesful\n" , strShaderType );
+	}
+
+	return shader;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+#include <GL/glew.h>
+
+//Compiles a shader stage, the info log goes to stderr on failure
+GLuint createShader(GLenum eShaderType, const std::string &strShaderFile);
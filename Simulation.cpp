@@ -0,0 +1,298 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "Collision.h"
+
+
+void initSimState(SimState& state){
+	state = SimState();
+	state.paddle[0] = glm::vec2(-0.55f, 0.55f);
+	state.paddle[1] = glm::vec2(0.55f, 0.55f);
+	state.ball = glm::vec2(0.0f, 0.55f);
+	state.ball_velocity = glm::vec2(1.0f * ball_speed, 0.0f);
+}
+
+static glm::vec2 inputDirection(std::uint8_t input){
+	glm::vec2 direction(0.0f, 0.0f);
+	if (input & INPUT_UP)
+		direction.y += 1;
+	if (input & INPUT_DOWN)
+		direction.y -= 1;
+	if (input & INPUT_LEFT)
+		direction.x -= 1;
+	if (input & INPUT_RIGHT)
+		direction.x += 1;
+	return direction;
+}
+
+bool stepSimulation(SimState& state, const TickInput& input){
+	for (int i = 0; i < 2; ++i)
+		state.paddle[i] += inputDirection(input.player[i]) * (sim_delta_time * paddle_speed);
+
+	getBallVelocity(state.ball, state.ball_velocity);
+	state.ball += state.ball_velocity * sim_delta_time;
+
+	//The paddles are moved by input only, the ball takes the whole response
+	const PhysicsMaterial material = combineMaterials(paddle_material, ball_material);
+	bool hit = false;
+	for (int i = 0; i < 2; ++i){
+		ContactManifold contact;
+		if (getContact(state.paddle[i], glm::vec2(paddle_size), state.ball, glm::vec2(ball_size), contact) &&
+			resolveStaticContact(contact, material, state.ball, state.ball_velocity))
+			hit = true;
+	}
+
+	if (hit)
+		++state.hits;
+	++state.tick;
+	return hit;
+}
+
+std::uint64_t hashState(const SimState& state){
+	//Multiply / xorshift per 64 bit word, SimState has no padding to skip
+	const std::uint64_t prime = 0x9E3779B97F4A7C15ull;
+	std::uint64_t hash = 0xCBF29CE484222325ull;
+
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&state);
+	for (std::size_t i = 0; i < sizeof(SimState); i += sizeof(std::uint64_t)){
+		std::uint64_t word;
+		std::memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+
+SnapshotHistory::SnapshotHistory(std::uint32_t window) :
+	window(window), states(window), hashes(window) {
+	for (SimState& state : states)
+		state.tick = UINT32_MAX;
+}
+
+void SnapshotHistory::save(const SimState& state){
+	std::uint32_t index = state.tick % window;
+	std::memcpy(&states[index], &state, sizeof(SimState));
+	hashes[index] = hashState(state);
+}
+
+bool SnapshotHistory::restore(std::uint32_t tick, SimState& state) const {
+	const SimState& saved = states[tick % window];
+	if (saved.tick != tick)
+		return false;
+	std::memcpy(&state, &saved, sizeof(SimState));
+	return true;
+}
+
+bool SnapshotHistory::hash(std::uint32_t tick, std::uint64_t& hash) const {
+	if (states[tick % window].tick != tick)
+		return false;
+	hash = hashes[tick % window];
+	return true;
+}
+
+
+RollbackSession::RollbackSession(const SimState& initial, int local_player, std::uint32_t history_window) :
+	state(initial), history(history_window), local_player(local_player), inputs(2 * history_window) {
+}
+
+RollbackSession::InputSlot& RollbackSession::slot(std::uint32_t tick){
+	InputSlot& input = inputs[tick % inputs.size()];
+	if (input.tick != tick){
+		input = InputSlot();
+		input.tick = tick;
+	}
+	return input;
+}
+
+const RollbackSession::InputSlot* RollbackSession::find(std::uint32_t tick) const {
+	const InputSlot& input = inputs[tick % inputs.size()];
+	return input.tick == tick ? &input : nullptr;
+}
+
+void RollbackSession::updateConfirmed(){
+	const InputSlot* input;
+	while (confirmed < state.tick && (input = find(confirmed)) && input->remote_confirmed)
+		++confirmed;
+}
+
+void RollbackSession::addLocalInput(std::uint32_t tick, std::uint8_t input){
+	slot(tick).local = input;
+}
+
+bool RollbackSession::addRemoteInput(std::uint32_t tick, std::uint8_t input){
+	//Either the snapshot this tick starts from is gone or it is further ahead than the
+	//ring holds without evicting a tick that can still be rolled back to
+	if (tick + history.getWindow() <= state.tick || tick >= state.tick + history.getWindow())
+		return false;
+
+	InputSlot& remote = slot(tick);
+	remote.remote = input;
+	remote.remote_confirmed = true;
+	last_remote = input;
+
+	//Only a misprediction of a tick we already simulated forces a rollback
+	if (tick < state.tick && remote.used != input)
+		rollback_tick = std::min(rollback_tick, tick);
+
+	updateConfirmed();
+	return true;
+}
+
+TickInput RollbackSession::inputFor(std::uint32_t tick){
+	InputSlot& input = slot(tick);
+
+	//Prediction repeats the last remote input that arrived
+	if (!input.remote_confirmed)
+		input.remote = last_remote;
+	input.used = input.remote;
+
+	TickInput tick_input;
+	tick_input.player[local_player] = input.local;
+	tick_input.player[1 - local_player] = input.remote;
+	return tick_input;
+}
+
+void RollbackSession::simulate(){
+	history.save(state);
+	stepSimulation(state, inputFor(state.tick));
+}
+
+void RollbackSession::resolve(){
+	if (rollback_tick < state.tick){
+		std::uint32_t present = state.tick;
+		auto start = std::chrono::steady_clock::now();
+		if (history.restore(rollback_tick, state)){
+			std::uint32_t distance = present - rollback_tick;
+			while (state.tick < present)
+				simulate();
+
+			++stats.rollbacks;
+			stats.resimulated_ticks += distance;
+			stats.max_rollback = std::max(stats.max_rollback, distance);
+			stats.resimulate_ms += std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - start).count();
+		}
+	}
+	rollback_tick = UINT32_MAX;
+}
+
+void RollbackSession::advance(){
+	resolve();
+	simulate();
+	++stats.ticks;
+	updateConfirmed();
+}
+
+bool RollbackSession::confirmedHash(std::uint32_t tick, std::uint64_t& hash) const {
+	//The snapshot of tick t is the state after every input up to t - 1
+	if (tick > confirmed)
+		return false;
+	if (tick == state.tick){
+		hash = hashState(state);
+		return true;
+	}
+	return history.hash(tick, hash);
+}
+
+
+//Deterministic per player input pattern, changes every few ticks like a held key
+static std::uint8_t loopbackInput(int player, std::uint32_t tick){
+	std::uint32_t x = (tick / 7 + 1) * 2654435761u ^ (player + 1) * 40503u;
+	x ^= x >> 13;
+	return std::uint8_t(x & (INPUT_UP | INPUT_DOWN | INPUT_LEFT | INPUT_RIGHT));
+}
+
+LoopbackResult runLoopback(std::uint32_t ticks, std::uint32_t delay, std::uint32_t history_window,
+	std::uint32_t lead){
+	LoopbackResult result;
+
+	SimState initial;
+	initSimState(initial);
+
+	SimState reference = initial;
+	for (std::uint32_t tick = 0; tick < ticks; ++tick){
+		TickInput input = { { loopbackInput(0, tick), loopbackInput(1, tick) } };
+		stepSimulation(reference, input);
+	}
+	result.reference_hash = hashState(reference);
+
+	RollbackSession peers[2] = {
+		RollbackSession(initial, 0, history_window),
+		RollbackSession(initial, 1, history_window),
+	};
+
+	struct Packet {
+		std::uint32_t deliver;
+		std::uint32_t tick;
+		std::uint8_t input;
+	};
+	std::vector<Packet> wire[2]; // wire[i] carries inputs to peer i, not in delivery order with a lead
+
+	auto start = std::chrono::steady_clock::now();
+
+	//Run past the end until the last inputs have crossed the wire
+	for (std::uint32_t now = 0; now <= ticks + delay; ++now){
+		for (int i = 0; i < 2; ++i){
+			auto delivered = std::stable_partition(wire[i].begin(), wire[i].end(),
+				[now](const Packet& packet){ return packet.deliver <= now; });
+			for (auto packet = wire[i].begin(); packet != delivered; ++packet)
+				peers[i].addRemoteInput(packet->tick, packet->input);
+			wire[i].erase(wire[i].begin(), delivered);
+		}
+
+		if (now >= ticks)
+			continue;
+
+		//The first iteration also sends the inputs of the ticks inside the lead
+		for (std::uint32_t tick = now ? now + lead : 0; tick <= now + lead && tick < ticks; ++tick){
+			for (int i = 0; i < 2; ++i){
+				std::uint8_t input = loopbackInput(i, tick);
+				peers[i].addLocalInput(tick, input);
+				//Inputs inside the lead count as sent before tick 0
+				bool early = lead && tick % 2 == 0;
+				std::uint32_t late = tick + delay >= lead ? tick + delay - lead : 0;
+				wire[1 - i].push_back({ early ? now : std::max(now, late), tick, input });
+			}
+		}
+
+		for (int i = 0; i < 2; ++i)
+			peers[i].advance();
+
+		//Both peers must agree on every tick they have confirmed
+		std::uint32_t confirmed = std::min(peers[0].confirmedTick(), peers[1].confirmedTick());
+		std::uint64_t hash0, hash1;
+		if (result.in_sync && peers[0].confirmedHash(confirmed, hash0) &&
+			peers[1].confirmedHash(confirmed, hash1) && hash0 != hash1){
+			result.in_sync = false;
+			result.desync_tick = confirmed;
+		}
+	}
+
+	//Apply the rollbacks caused by the final deliveries
+	for (int i = 0; i < 2; ++i)
+		peers[i].resolve();
+
+	std::uint64_t hash0 = 0, hash1 = 0;
+	if (!peers[0].confirmedHash(ticks, hash0) || !peers[1].confirmedHash(ticks, hash1) || hash0 != hash1){
+		result.in_sync = false;
+		result.desync_tick = ticks;
+	}
+	result.final_hash = hash0;
+	if (result.final_hash != result.reference_hash)
+		result.in_sync = false;
+
+	result.milliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+
+	result.stats = peers[0].getStats();
+	result.stats.ticks += peers[1].getStats().ticks;
+	result.stats.resimulated_ticks += peers[1].getStats().resimulated_ticks;
+	result.stats.rollbacks += peers[1].getStats().rollbacks;
+	result.stats.max_rollback = std::max(result.stats.max_rollback, peers[1].getStats().max_rollback);
+	result.stats.resimulate_ms += peers[1].getStats().resimulate_ms;
+	return result;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/*
+Description
+
+Deterministic pong simulation with snapshot / restore and rollback
+
+SimState is the whole game state in one memcpy-able block, stepped at a fixed
+tick rate from per player input bits.  SnapshotHistory keeps the last N states
+so a RollbackSession can rewind to the first tick a late remote input changed
+and resimulate up to the present.  Peers compare hashes of confirmed ticks to
+detect desyncs.
+
+*/
+
+const float sim_tick_rate = 60.0f;
+const float sim_delta_time = 1.0f / sim_tick_rate;
+
+const float paddle_speed = 3.0f; //3 units per second
+
+enum InputBits : std::uint8_t {
+	INPUT_UP = 1 << 0,
+	INPUT_DOWN = 1 << 1,
+	INPUT_LEFT = 1 << 2,
+	INPUT_RIGHT = 1 << 3,
+};
+
+struct TickInput {
+	std::uint8_t player[2];
+};
+
+struct SimState {
+	std::uint32_t tick;
+	std::uint32_t hits;
+	glm::vec2 paddle[2];
+	glm::vec2 ball;
+	glm::vec2 ball_velocity;
+};
+
+static_assert(std::is_trivially_copyable<SimState>::value, "SimState is copied with memcpy");
+static_assert(sizeof(SimState) % sizeof(std::uint64_t) == 0, "SimState is hashed a word at a time");
+
+//Start positions, same layout as initSceneSprites
+void initSimState(SimState& state);
+
+//Advances one tick, returns true when the ball hit a paddle
+bool stepSimulation(SimState& state, const TickInput& input);
+
+std::uint64_t hashState(const SimState& state);
+
+
+//Ring of the last window states, indexed by the tick they start
+class SnapshotHistory {
+public:
+	explicit SnapshotHistory(std::uint32_t window);
+
+	void save(const SimState& state);
+	bool restore(std::uint32_t tick, SimState& state) const;
+	bool hash(std::uint32_t tick, std::uint64_t& hash) const;
+
+	std::uint32_t getWindow() const { return window; }
+
+private:
+	std::uint32_t window;
+	std::vector<SimState> states;
+	std::vector<std::uint64_t> hashes;
+};
+
+
+struct RollbackStats {
+	std::uint64_t ticks = 0;
+	std::uint64_t resimulated_ticks = 0;
+	std::uint64_t rollbacks = 0;
+	std::uint32_t max_rollback = 0;
+	double resimulate_ms = 0.0; // spent restoring and resimulating
+};
+
+//One peer, local_player's input is known, the other player's is predicted until it arrives
+class RollbackSession {
+public:
+	RollbackSession(const SimState& initial, int local_player, std::uint32_t history_window);
+
+	void addLocalInput(std::uint32_t tick, std::uint8_t input);
+
+	//False when the input is outside the history window and cannot be applied
+	bool addRemoteInput(std::uint32_t tick, std::uint8_t input);
+
+	//Rolls back to the first mispredicted tick and resimulates up to the present
+	void resolve();
+
+	//resolve, then simulates the next tick
+	void advance();
+
+	const SimState& current() const { return state; }
+
+	//Latest tick whose inputs from both players are confirmed
+	std::uint32_t confirmedTick() const { return confirmed; }
+	bool confirmedHash(std::uint32_t tick, std::uint64_t& hash) const;
+
+	const RollbackStats& getStats() const { return stats; }
+
+private:
+	struct InputSlot {
+		std::uint32_t tick = UINT32_MAX;
+		std::uint8_t local = 0;
+		std::uint8_t remote = 0;
+		std::uint8_t used = 0; // remote input the last simulation of this tick ran with
+		bool remote_confirmed = false;
+	};
+
+	InputSlot& slot(std::uint32_t tick);
+	const InputSlot* find(std::uint32_t tick) const;
+	TickInput inputFor(std::uint32_t tick);
+	void simulate();
+	void updateConfirmed();
+
+	SimState state;
+	SnapshotHistory history;
+	int local_player;
+	std::vector<InputSlot> inputs; // twice the history window, remote input may arrive that far ahead
+
+	std::uint8_t last_remote = 0;
+	std::uint32_t rollback_tick = UINT32_MAX;
+	std::uint32_t confirmed = 0;
+	RollbackStats stats;
+};
+
+
+struct LoopbackResult {
+	bool in_sync = true;
+	std::uint32_t desync_tick = 0;
+	std::uint64_t final_hash = 0;
+	std::uint64_t reference_hash = 0;
+	RollbackStats stats;
+	double milliseconds = 0.0;
+};
+
+//Two sessions exchanging inputs that arrive delay ticks late, checked against a
+//reference run that knew every input up front.  With a lead each input is known
+//and sent lead ticks before its tick, every other one arrives at once and the
+//rest delay ticks later, so remote input lands both ahead of and behind a peer.
+LoopbackResult runLoopback(std::uint32_t ticks, std::uint32_t delay, std::uint32_t history_window,
+	std::uint32_t lead = 0);
@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <memory>
@@ -12,6 +17,15 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/polar_coordinates.hpp>
 
+#include "Particles.h"
+#include "Resources.h"
+#include "Scene.h"
+#include "Simulation.h"
+#include "TextOverlay.h"
+#include "TileMap.h"
+#include "Views.h"
+#include "WorkerPool.h"
+
 /*
 Description
 
@@ -26,101 +40,49 @@ using std::cout;
 using std::endl;
 
 //void printGLInfo(GLFWwindow* window);
-void getGLVersionInfo();
-GLuint createShader(GLenum eShaderType, const std::string &strShaderFile);
-
+void getGLVersionInfo(GLFWwindow* window);
 
-const float speed = 3.0f; //3 units per second
-const float ball_speed = 0.5f; //3 units per second
 
 const float animation_speed = 1.0f; // 1 frame units per second
 
-const float paddle_size = 0.15f;
-const float ball_size = 0.05f;
-
-enum SQUARE { SQUARE1, SQUARE2 };
-
-unsigned char* load_bmp(std::string image_path , unsigned int& width , unsigned int& height );
-glm::vec2 getPosFromControls(GLFWwindow* window , double deltaTime, SQUARE square);
-glm::vec2& getBallVelocity(glm::vec2& pos, glm::vec2& velocity );
+const unsigned impact_particles = 1 << 16; //burst when the ball hits a paddle
+const unsigned trail_particles = 1 << 11; //emitted behind the ball every frame
 
+const float max_frame_time = 0.25f; //ticks dropped after a stall instead of catching up
 
+const unsigned level_size = 4096; //tiles per side of the background level
+const float level_scroll_speed = 4.0f; //tiles per second
 
+//Long sessions have to stay inside these, the registry warns when they do not
+const std::size_t vram_budget = std::size_t(256) << 20;
+const std::size_t ram_budget = std::size_t(512) << 20;
 
-struct Rectangle {
-	Rectangle(float left, float top, float  right, float bottom) :
-	left(left), top(top), right(right), bottom(bottom)	{}
-	float left;
-	float right;
-	float top;
-	float bottom;
-};
+const float overlay_margin = 8.0f; //pixels from the top left of the window
+const float overlay_value_column = 200.0f;
 
+//--kiosk windows show each player's half of the court, one view per paddle
+const int kiosk_width = 512, kiosk_height = 384;
+const glm::vec2 kiosk_half_extent(0.4f, 0.6f); // matches half a kiosk window
 
-struct Sprite {
-	Sprite(glm::vec2 size_in, glm::vec2 pos_in) : size(size_in), pos(pos_in)  {
-	}
-	Sprite() {
-	}
-	void setPos(float x , float y){
-		pos.x = x;
-		pos.y = y;
-		update();
-	}
-	void adjustPos(glm::vec2 pos){
-		this->pos += pos;
-		update();
-	}
-	void setSize(float x, float y){
-		size.x = x;
-		size.y = y;
-		update();
-	}
-	void setSize(glm::vec2 size){
-		this->size = size;
-		update();
-	}
-	void update(){
-		world_transform = glm::translate(glm::vec3(pos, 0.0f)) * glm::scale(glm::vec3(size, 1.0f));
-	}
-	glm::mat4& getWorldTransform(){
-		return world_transform;
-	}
-	void setVelocity(float x, float y){
-		velocity.x = x;
-		velocity.y = y;
-	}
-
-
-	Rectangle getBoundingBox(){
-		float left, right, top, bottom;
-		left = pos.x - size.x;
-		right = pos.x + size.x;
-		top = pos.y + size.y;
-		bottom = pos.y - size.y;
+enum SQUARE { SQUARE1, SQUARE2 };
 
-		return Rectangle(left, top, right, bottom);
-	}
+std::uint8_t getInputFromControls(GLFWwindow* window, SQUARE square);
+int runRollbackTest();
 
 
-	glm::vec2 velocity{ 0.15f, 0.15f };
-	glm::vec2 size{0.15f,0.15f};
-	glm::vec2 pos{ 0.0f , 0.0f };
-	glm::mat4 world_transform;
-};
+int main(int argc, char* argv[]){
 
-bool collision(Sprite& sprite1, Sprite& sprite2);
-glm::vec2 getCollisionVector(Sprite& sprite1, Sprite& sprite2);
+	if (argc > 1 && std::string(argv[1]) == "--rollback-test")
+		return runRollbackTest();
 
-int main(void){
+	unsigned kiosk_windows = 0;
+	if (argc > 2 && std::string(argv[1]) == "--kiosk")
+		kiosk_windows = unsigned(std::max(std::atoi(argv[2]), 0));
 
 	if (!glfwInit()){
 		cout << "Error Initializing GLFW" << endl;
 	}
 
-
-	getGLVersionInfo();
-
 	glfwWindowHint(GLFW_SAMPLES, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -142,7 +104,7 @@ int main(void){
 		return -1;
 	}
 
-	//printGLInfo(window);
+	getGLVersionInfo(window);
 
 
 	// Ensure we can capture the escape key being pressed below
@@ -151,352 +113,83 @@ int main(void){
 	// Dark blue background
 	glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
+	if (argc > 1 && std::string(argv[1]) == "--bench-particles"){
+		benchmarkParticles(particle_capacity, 100);
+		glfwTerminate();
+		return 0;
+	}
 
 
-	//static const char * vs_source[] =
-	static const std::string vs_source =
-	{
-		"#version 330 core                                                 \n"
-		"                                                                  \n"
-		"layout(location = 0) in vec3 vertexPosition_modelspace;           \n"
-		"layout(location = 1) in vec3 vertex_color;                        \n"
-		"                                                                  \n"
-		"uniform mat4 world_space;                                         \n"
-		"                                                                  \n"
-		"smooth out vec4 color;                                            \n"
-		"                                                                  \n"
-		"                                                                  \n"
-		"void main(){                                                      \n"
-		"    gl_Position = world_space                                     \n"
-		"               * vec4( vertexPosition_modelspace , 1.0f);         \n"
-		"                                                                  \n"
-		"    color = vec4(vertex_color,1.0);                               \n"
-		"}                                                                 \n"
-	};
-
-
-	static const std::string fs_source = 
-	{
-		"#version 330 core                                                 \n"
-		"                                                                  \n"
-		"smooth in vec4 color;                                             \n"
-		"                                                                  \n"
-		"// Ouput data                                                     \n"
-		"out vec4 output_color;                                            \n"
-		"                                                                  \n"
-		"void main(void)                                                   \n"
-		"{                                                                 \n"
-		"    output_color = color;                                         \n"
-		"}                                                                 \n"
-	};
-
-
-	static const std::string vs_source_texture =
-	{
-		"#version 330 core                                                 \n"
-		"                                                                  \n"
-		"layout(location = 0) in vec3 vertexPosition_modelspace;           \n"
-		"layout(location = 2) in vec2 texture_pos;                         \n"
-		"                                                                  \n"
-		"uniform mat4 world_space;                                         \n"
-		"                                                                  \n"
-		"smooth out vec4 color;                                            \n"
-		"smooth out vec2 texture_coord;                                    \n"
-		"                                                                  \n"
-		"void main(){                                                      \n"
-		"    gl_Position = world_space                                     \n"
-		"               * vec4( vertexPosition_modelspace , 1.0f);         \n"
-		"    texture_coord = texture_pos;                                  \n"
-		"    color = vec4(1.0,1.0,1.0,1.0);                                \n"
-		"}                                                                 \n"
-	};
-
-
-	static const std::string fs_source_texture =
-	{
-		"#version 330 core                                                 \n"
-		"                                                                  \n"
-		"smooth in vec4 color;                                             \n"
-		"smooth in vec2 texture_coord;                                     \n"
-		"uniform sampler2D tex;                                            \n"
-		"                                                                  \n"
-		"// Ouput data                                                     \n"
-		"out vec4 output_color;                                            \n"
-		"                                                                  \n"
-		"void main(void)                                                   \n"
-		"{                                                                 \n"		
-		"    output_color = texture(tex, texture_coord);                   \n"
-		"    //output_color = vec4(0.5 , 0.5 , 0.5 , 1.0 );                \n"
-		"    //output_color = texture(tex, texture_coord) * color;         \n"
-		"}                                                                 \n"
-	};
-	
-
-	static const std::string vs_source_animation =
-	{
-		"#version 330 core                                                 \n"
-		"                                                                  \n"
-		"layout(location = 0) in vec3 vertexPosition_modelspace;           \n"
-		"layout(location = 2) in vec2 texture_pos;                         \n"
-		"                                                                  \n"
-		"                                                                  \n"
-		"uniform mat4 world_space;                                         \n"
-		"uniform uint animation_index;                                     \n"
-		"uniform uvec2 sprite_grid;                                        \n"
-		"                                                                  \n"
-		"smooth out vec4 color;                                            \n"
-		"smooth out vec2 texture_coord;                                    \n"
-		"                                                                  \n"
-		"void main(){                                                      \n"
-		"    gl_Position = world_space                                     \n"
-		"               * vec4( vertexPosition_modelspace , 1.0f);         \n"			
-		"                                                                  \n"
-		"    vec2 cell_size =  vec2(1.0,1.0);                              \n"
-		"    cell_size.x /= sprite_grid.x;                                 \n"
-		"    cell_size.y /= sprite_grid.y;                                 \n"
-		"                                                                  \n"
-		"    uvec2 grid_location = uvec2(0,0);                             \n"
-		"    grid_location.x = animation_index % sprite_grid.x;           \n"		
-		"    grid_location.y = animation_index / sprite_grid.y;            \n"
-		"                                                                  \n"
-		"    texture_coord = texture_pos;                                  \n"
-		"    texture_coord.x /= sprite_grid.x;                             \n"
-		"    texture_coord.y /= sprite_grid.y;                             \n"
-		"                                                                  \n"
-		"    texture_coord.x += (grid_location.x * cell_size.x);           \n"
-		"    texture_coord.y += (grid_location.y * cell_size.y);           \n"	
-		"    color = vec4(0.5,0.5,0.5,1.0);                                \n"
-		"}                                                                 \n"
-	};
-
-
-	static const std::string fs_source_animation =
-	{
-		"#version 330 core                                                 \n"
-		"                                                                  \n"
-		"smooth in vec4 color;                                             \n"
-		"smooth in vec2 texture_coord;                                     \n"
-		"uniform sampler2D tex;                                            \n"
-		"                                                                  \n"
-		"// Ouput data                                                     \n"
-		"out vec4 output_color;                                            \n"
-		"                                                                  \n"
-		"void main(void)                                                   \n"
-		"{                                                                 \n"
-		"    output_color = texture(tex, texture_coord);                   \n"
-		"    //int test = 1 % 2;                  \n"
-		"    //output_color = vec4(0.5 , 0.5 , 0.5 , 1.0 );                \n"
-		"    //output_color = texture(tex, texture_coord) * color;         \n"
-		"}                                                                 \n"
-	};
-
-	
-
-	/*
-
-	static const std::string vs_source_animation =
-	{
-		"#version 330 core                                                 \n"
-		"                                                                  \n"
-		"layout(location = 0) in vec3 vertexPosition_modelspace;           \n"
-		"layout(location = 2) in vec2 texture_pos;                         \n"
-		"                                                                  \n"
-		"uniform mat4 world_space;                                         \n"
-		"                                                                  \n"
-		"smooth out vec4 color;                                            \n"
-		"smooth out vec2 texture_coord;                                    \n"
-		"                                                                  \n"
-		"void main(){                                                      \n"
-		"    gl_Position = world_space                                     \n"
-		"               * vec4( vertexPosition_modelspace , 1.0f);         \n"
-		"    texture_coord = texture_pos;                                  \n"
-		"    color = vec4(1.0,1.0,1.0,1.0);                                \n"
-		"}                                                                 \n"
-	};
-
-
-	static const std::string fs_source_animation =
-	{
-		"#version 330 core                                                 \n"
-		"                                                                  \n"
-		"smooth in vec4 color;                                             \n"
-		"smooth in vec2 texture_coord;                                     \n"
-		"uniform sampler2D tex;                                            \n"
-		"                                                                  \n"
-		"// Ouput data                                                     \n"
-		"out vec4 output_color;                                            \n"
-		"                                                                  \n"
-		"void main(void)                                                   \n"
-		"{                                                                 \n"
-		"    output_color = texture(tex, texture_coord);                   \n"
-		"    //output_color = vec4(0.5 , 0.5 , 0.5 , 1.0 );                \n"
-		"    //output_color = texture(tex, texture_coord) * color;         \n"
-		"}                                                                 \n"
-	};*/
-
-	GLuint program = glCreateProgram();	
-	GLuint fs = createShader(GL_FRAGMENT_SHADER, fs_source);	
-	GLuint vs = createShader(GL_VERTEX_SHADER, vs_source);
-	glAttachShader(program, vs);
-	glAttachShader(program, fs);
-	glLinkProgram(program);
-
-	GLuint program_texture = glCreateProgram();
-	GLuint fs_tex = createShader(GL_FRAGMENT_SHADER, fs_source_texture );
-	GLuint vs_tex = createShader(GL_VERTEX_SHADER, vs_source_texture );
-	glAttachShader(program_texture, vs_tex);
-	glAttachShader(program_texture, fs_tex);
-	glLinkProgram(program_texture);
-
-	GLuint program_animation = glCreateProgram();
-	GLuint fs_ani = createShader(GL_FRAGMENT_SHADER, fs_source_animation);
-	GLuint vs_ani = createShader(GL_VERTEX_SHADER, vs_source_animation);
-	glAttachShader(program_animation, vs_ani);
-	glAttachShader(program_animation, fs_ani);
-	glLinkProgram(program_animation);
-
-	GLint pass_fail;
-	glGetProgramiv(program_animation, GL_LINK_STATUS, &pass_fail);
-
-	if (pass_fail != GL_TRUE)
-		std::cout << "WARNING DID NOT LINK" << endl;
-
-	glDeleteShader(fs);
-	glDeleteShader(vs);
-	glDeleteShader(fs_tex);
-	glDeleteShader(vs_tex);
-	glDeleteShader(fs_ani);
-	glDeleteShader(vs_ani);
-
-	GLuint VertexArrayID;
-	glGenVertexArrays(1, &VertexArrayID);
-	glBindVertexArray(VertexArrayID);
-
-	//Structure of Arrays  Triangles then Colors
-	static const GLfloat g_vertex_buffer_data[] = {
-		//First Triangle
-		-1.0f, -1.0f, 0.0f,
-		-1.0f, 1.0f, 0.0f,
-		1.0f, -1.0f, 0.0f,		
-
-		//Second Triangle
-		1.0f, 1.0f, 0.0f,
-		1.0f, -1.0f, 0.0f,
-		-1.0f, 1.0f, 0.0f,
-
-		//First Color
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-
-
-		//Second Color
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-	};
-
-
-	//Array of structures, interlace triangles, color, and texture coordinates
-	//To do, use an element buffer	
-	static const GLfloat g_vertex_buffer_data_texture[] = {
-		//First Triangle      //Coordinates
-		-1.0f, -1.0f, 0.0f,   0.0f , 0.0f,
-		-1.0f, 1.0f, 0.0f,    0.0f , 1.0f,
-		1.0f, -1.0f, 0.0f,    1.0f , 0.0f,
-
-		//Second Triangle
-		1.0f, 1.0f, 0.0f,    1.0f , 1.0f ,
-		1.0f, -1.0f, 0.0f,   1.0f , 0.0f ,
-		-1.0f, 1.0f, 0.0f,   0.0f , 1.0f , 
-
-	};
-
-
-
-
-
-
-	int texture_data_per_triangle = 5;
-	//int texture_stride = texture_data_per_triangle * sizeof(g_vertex_buffer_data_texture) / sizeof(g_vertex_buffer_data_texture[0]) * sizeof(GLfloat);
-	int texture_stride = texture_data_per_triangle * sizeof(GLfloat);
-
-
-	GLuint vertexbuffer;
-	glGenBuffers(1, &vertexbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-
-	GLuint vertexbufferTexture;
-	glGenBuffers(1, &vertexbufferTexture);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbufferTexture);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data_texture), g_vertex_buffer_data_texture, GL_STATIC_DRAW);
-
-
-	GLuint titleID, marioID;
-	glGenTextures(1, &titleID);
-
-	unsigned int height{0}, width{0};
-	std::unique_ptr<unsigned char> data ( load_bmp("Title.bmp" , width , height ) );
-
-	glBindTexture(GL_TEXTURE_2D, titleID);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data.get() );
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-
-	data.reset( load_bmp("Mario.bmp", width, height));
-	glGenTextures(1, &marioID);
-	glBindTexture(GL_TEXTURE_2D, marioID);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data.get() );
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	ResourceRegistry::get().setBudget(vram_budget, ram_budget);
 
+	std::unique_ptr<SceneResources> scene(new SceneResources);
+	if (!createSceneResources(*scene))
+		cout << "WARNING SCENE DID NOT LOAD" << endl;
 
-	GLuint worldTransformPos = glGetUniformLocation(program, "world_space");
-	GLuint worldTransformPos1 = glGetUniformLocation(program_texture, "world_space");
-	GLuint worldTransformPos2 = glGetUniformLocation(program_animation, "world_space");
-	GLuint animationIndexPos = glGetUniformLocation(program_animation, "animation_index");
-	GLuint spriteGridPos = glGetUniformLocation(program_animation, "sprite_grid");
-	//GLuint spriteGridRowsPos = glGetUniformLocation(program_animation, "sprite_grid.columns");
+	//Extra windows share the scene, paddle1 on the left of each and paddle2 on the right
+	WorkerPool workers;
+	std::unique_ptr<ViewRenderer> views;
+	if (kiosk_windows){
+		views.reset(new ViewRenderer(window, *scene, workers));
+		for (unsigned i = 0; i < kiosk_windows; ++i){
+			GLFWwindow* kiosk = views->addWindow(kiosk_width, kiosk_height, "Kiosk");
+			if (!kiosk){
+				cout << "WARNING KIOSK WINDOW " << i << " DID NOT OPEN" << endl;
+				break;
+			}
+			views->addView(kiosk, glm::vec4(0.0f, 0.0f, 0.5f, 1.0f));
+			views->addView(kiosk, glm::vec4(0.5f, 0.0f, 0.5f, 1.0f));
+		}
+	}
+	double view_prepare_ms = 0.0, view_submit_ms = 0.0;
+	unsigned view_frames = 0;
 
 	double lastTime = glfwGetTime();
 	double currentTime;
 	float deltaTime = 0.0f;
 
 
+	SceneSprites sprites;
+	initSceneSprites(sprites);
 
-	Sprite paddle1, paddle2, ball;
-
-	paddle1.setPos(-0.55f, 0.55f);
-	paddle2.setPos(0.55f, 0.55f);
-	ball.setPos(0.0f, 0.55f);
-
-	paddle1.setSize(paddle_size, paddle_size);
-	paddle2.setSize(paddle_size, paddle_size);
-	ball.setSize(ball_size, ball_size);
-
-	ball.setVelocity(1.0f * ball_speed, 0.0f);
-
-	Sprite title, mario;
-	title.setPos(-0.55f, -0.55f);
-	title.setSize(0.15f, 0.15f);
+	//Background level sliced from the mario sheet, scrolls behind the game
+	TileSet tileset;
+	std::unique_ptr<TileMap> level;
+	if (createTileSet("Mario.bmp", 10, 5, tileset)){
+		level.reset(new TileMap(level_size, level_size, tileset));
+		generateTileMap(*level, 1);
+	}
+	//Units are tiles
+	Camera2D level_camera;
+	level_camera.center = glm::vec2(level_size / 2.0f);
+	level_camera.half_extent = glm::vec2(32.0f, 24.0f);
 
-	mario.setPos(0.55f, -0.55f);
-	mario.setSize(0.15f, 0.15f);
+	//Gameplay runs at a fixed tick rate so it can be snapshot and replayed
+	SimState state;
+	initSimState(state);
+	float tick_accumulator = 0.0f;
 
-	//colums then rows
-	glm::u32vec2 sprite_grid(10,5);
-	
-	GLuint animationIndex = 0;
 	float current_animation_time{ 0 };
 
+	std::unique_ptr<ParticleSystem> particles(new ParticleSystem(chooseParticleBackend()));
+	glPointSize(2.0f);
+
+	//Live stats, the labels are static text and only the numbers change per frame
+	GlyphAtlas font;
+	std::unique_ptr<TextOverlay> overlay;
+	const char* overlay_labels[] = { "FPS", "FRAME MS", "WORST MS", "DRAWS", "SPRITES", "PARTICLES", "OVERLAY MS", "VRAM MB", "RAM MB" };
+	const int overlay_lines = sizeof(overlay_labels) / sizeof(overlay_labels[0]);
+	if (createGlyphAtlas("text.bmp", font)){
+		overlay.reset(new TextOverlay(font));
+		for (int i = 0; i < overlay_lines; ++i)
+			overlay->addStaticText(glm::vec2(overlay_margin, overlay_margin + i * overlay->getLineHeight()), overlay_labels[i]);
+		overlay->addStaticText(glm::vec2(overlay_margin, overlay_margin + (overlay_lines + 1) * overlay->getLineHeight()),
+			(const char*)glGetString(GL_RENDERER), glm::vec3(0.6f));
+	}
+	FrameTimer frame_timer;
+	unsigned overlay_draw_calls = 0;
+
 
 
 
@@ -516,24 +209,6 @@ int main(void){
 	*/
 
 
-	//Set buffer
-	// 1rst attribute buffer : vertices
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)72);
-
-	//Set second buffer
-	//this is for mario title screen
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbufferTexture);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, texture_stride, (void*)0);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, texture_stride, (void*)(3 * sizeof(GLfloat)));
-	
-
-
 	do{
 
 		currentTime = glfwGetTime();
@@ -542,69 +217,87 @@ int main(void){
 	
 		glClear(GL_COLOR_BUFFER_BIT);
 		
-		//Paddles
-		glUseProgram(program);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-
-		//Paddle1
-		paddle1.adjustPos(getPosFromControls(window, deltaTime, SQUARE1));
-		glUniformMatrix4fv(worldTransformPos, 1, GL_FALSE, glm::value_ptr(paddle1.getWorldTransform()));		
-		glDrawArrays(GL_TRIANGLES, 0, 6 ); 
-
-		//Paddle2
-		paddle2.adjustPos(getPosFromControls(window, deltaTime, SQUARE2));
-		glUniformMatrix4fv(worldTransformPos, 1, GL_FALSE, glm::value_ptr(paddle2.getWorldTransform()));
-		glDrawArrays(GL_TRIANGLES, 0, 6 ); 
-
-		//Ball		
-		getBallVelocity( ball.pos , ball.velocity  );
-		ball.adjustPos( ball.velocity * deltaTime);
-
-		if (collision(paddle1, ball))
-			ball.velocity.x *= -1;
-
-		if (collision(paddle2, ball))
-			ball.velocity.x *= -1;
-	
-		glUniformMatrix4fv(worldTransformPos, 1, GL_FALSE, glm::value_ptr(ball.getWorldTransform()));	
-		glDrawArrays(GL_TRIANGLES, 0, 6); // 3 indices starting at 0 -> 1 triangle		
-	
-
-
-
-		//Lets do the texture here		
-		glBindTexture(GL_TEXTURE_2D, titleID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbufferTexture);
-		glUseProgram(program_texture);		
-		glUniformMatrix4fv(worldTransformPos1, 1, GL_FALSE, glm::value_ptr(title.getWorldTransform()));
-		glDrawArrays(GL_TRIANGLES, 0, 6); // 3 indices starting at 0 -> 1 triangle	
-	
+		tick_accumulator = std::min(tick_accumulator + deltaTime, max_frame_time);
+		while (tick_accumulator >= sim_delta_time){
+			TickInput input = { { getInputFromControls(window, SQUARE1), getInputFromControls(window, SQUARE2) } };
+			if (stepSimulation(state, input))
+				particles->emit(state.ball, state.ball_velocity, 1.0f, 2.0f, impact_particles);
+			tick_accumulator -= sim_delta_time;
+		}
 
+		sprites.paddle1.setPos(state.paddle[0].x, state.paddle[0].y);
+		sprites.paddle2.setPos(state.paddle[1].x, state.paddle[1].y);
+		sprites.ball.setPos(state.ball.x, state.ball.y);
 
 		//Animation
-		//glUseProgram(program_texture);
-		glUseProgram(program_animation);
-
-		glBindTexture(GL_TEXTURE_2D, marioID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbufferTexture);
-	
-		
 		current_animation_time += deltaTime;
 
-		if (current_animation_time > animation_speed){
+		if (current_animation_time > animation_speed && scene->frameCount){
 			current_animation_time = 0;
-			++animationIndex;
+			sprites.animationIndex = (sprites.animationIndex + 1) % scene->frameCount;
+		}
+
+		unsigned draw_calls = overlay_draw_calls;
+		if (level){
+			//Start over from the left edge before the view leaves the map
+			float scroll_range = level->getWidth() - 2.0f * level_camera.half_extent.x;
+			level_camera.center.x = level_camera.half_extent.x + std::fmod(
+				level_camera.center.x - level_camera.half_extent.x + level_scroll_speed * deltaTime, scroll_range);
+			level->draw(scene->program_texture, level_camera);
+			draw_calls += level->getStats().draw_calls;
+		}
+
+		//One draw per visible sprite, culled sprites are not counted
+		unsigned sprite_draws = drawScene(*scene, &sprites, 1);
+
+		if (views){
+			for (std::size_t i = 0; i < views->getViewCount(); ++i){
+				Camera2D& camera = views->getCamera(i);
+				camera.center = state.paddle[i % 2];
+				camera.half_extent = kiosk_half_extent;
+			}
+			views->prepare(&sprites, 1);
+			sprite_draws += views->submit();
+			view_prepare_ms += views->getStats().prepare_ms;
+			view_submit_ms += views->getStats().submit_ms;
+			++view_frames;
+		}
+		draw_calls += sprite_draws;
+
+		//Particles, trail behind the ball
+		particles->emit(state.ball, state.ball_velocity * -0.25f, 0.05f, 0.5f, trail_particles);
+		particles->update(deltaTime);
+		particles->draw();
+		if (particles->size())
+			++draw_calls;
+
+		frame_timer.tick(deltaTime);
+		if (overlay){
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			overlay->setScreenSize(width, height);
+
+			const ResourceRegistry& registry = ResourceRegistry::get();
+			const float megabyte = 1024.0f * 1024.0f;
+
+			char value[32];
+			const float values[] = { frame_timer.getFps(), frame_timer.getFrameMs(), frame_timer.getWorstMs(),
+				float(draw_calls), float(sprite_draws), float(particles->size()), overlay->getStats().cpu_ms,
+				registry.getVramBytes() / megabyte, registry.getRamBytes() / megabyte };
+			const char* formats[] = { "%.2f", "%.2f", "%.2f", "%.0f", "%.0f", "%.0f", "%.2f", "%.1f", "%.1f" };
+			for (int i = 0; i < overlay_lines; ++i){
+				snprintf(value, sizeof(value), formats[i], values[i]);
+				overlay->print(glm::vec2(overlay_value_column, overlay_margin + i * overlay->getLineHeight()), value,
+					glm::vec3(1.0f, 0.85f, 0.3f));
+			}
+			overlay->draw();
+			overlay_draw_calls = overlay->getStats().draw_calls;
 		}
-		
-		glUniformMatrix4fv(worldTransformPos2, 1, GL_FALSE, glm::value_ptr(mario.getWorldTransform()));
-		glUniform1ui(animationIndexPos, animationIndex );
-		glUniform2uiv(spriteGridPos, 1, glm::value_ptr(sprite_grid));
-		
-		glDrawArrays(GL_TRIANGLES, 0, 6); // 3 indices starting at 0 -> 1 triangle	
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		// Swap buffers
 		glfwSwapBuffers(window);
+		if (views)
+			views->present();
 		glfwPollEvents();
 
 		lastTime = currentTime;
@@ -616,10 +309,25 @@ int main(void){
 //	if (data != nullptr)
 //		delete [] data;
 
-	// Cleanup VBO
-	glDeleteBuffers(1, &vertexbuffer);
-	glDeleteVertexArrays(1, &VertexArrayID);
-	glDeleteProgram(program);
+	// Cleanup, every GL object has to be released while the context is alive
+	if (overlay)
+		printf("Overlay: %u of %u frames over the %.2f ms budget\n",
+			overlay->getStats().frames_over_budget, overlay->getStats().frames, text_overlay_budget_ms);
+	if (views && view_frames)
+		printf("Views: %zu, %.3f ms prepare and %.3f ms submit per frame\n", views->getViewCount(),
+			view_prepare_ms / view_frames, view_submit_ms / view_frames);
+	ResourceRegistry::get().printUsage(stdout);
+
+	views.reset();
+	scene.reset();
+	particles.reset();
+	level.reset();
+	tileset.texture.reset();
+	overlay.reset();
+	font.texture.reset();
+
+	if (std::size_t leaks = ResourceRegistry::get().reportLeaks(stderr))
+		cout << "WARNING " << leaks << " GL OBJECTS LEAKED" << endl;
 
 
 	// Close OpenGL window and terminate GLFW
@@ -632,70 +340,6 @@ int main(void){
 
 
 
-unsigned char* load_bmp(std::string image_path, unsigned int& width, unsigned int& height){
-	using namespace std;
-
-	cout << "Reading image: " << image_path << endl;
-
-	// Data read from the header of the BMP file
-	unsigned char header[54];
-	unsigned int dataPos;
-	unsigned int imageSize;
-	//unsigned int width, height;
-	// Actual RGB data
-	unsigned char * data;
-
-	// Open the file
-	FILE * file = fopen(image_path.c_str(), "rb");
-	if (!file)							    {
-		cout << image_path << "could not be opened. Are you in the right directory ? Don't forget to read the FAQ !" << endl;
-		getchar();
-		return nullptr;
-	}
-
-	// Read the header, i.e. the 54 first bytes
-
-	// If less than 54 bytes are read, problem
-	if (fread(header, 1, 54, file) != 54){
-		cout << "Not a correct BMP file" << endl;
-		return nullptr;
-	}
-	// A BMP files always begins with "BM"
-	if (header[0] != 'B' || header[1] != 'M'){
-		cout << "Not a correct BMP file" << endl;
-		return nullptr;
-	}
-	// Make sure this is a 24bpp file
-	if (*(int*)&(header[0x1E]) != 0)         {
-		cout << "Not a correct BMP file" << endl;
-		return nullptr;
-	}
-	if (*(int*)&(header[0x1C]) != 24)         {
-		cout << "Not a correct BMP file" << endl;
-		return nullptr;
-	}
-
-	// Read the information about the image
-	dataPos = *(int*)&(header[0x0A]);
-	imageSize = *(int*)&(header[0x22]);
-	width = *(int*)&(header[0x12]);
-	height = *(int*)&(header[0x16]);
-
-	// Some BMP files are misformatted, guess missing information
-	if (imageSize == 0)    imageSize = width*height * 3; // 3 : one byte for each Red, Green and Blue component
-	if (dataPos == 0)      dataPos = 54; // The BMP header is done that way
-
-	// Create a buffer
-	data = new unsigned char[imageSize];
-
-	// Read the actual data from the file into the buffer
-	fread(data, 1, imageSize, file);
-
-	// Everything is in memory now, the file wan be closed
-	fclose(file);
-
-	return data;
-}
 
 
 
@@ -707,67 +351,8 @@ unsigned char* load_bmp(std::string image_path, unsigned int& width, unsigned in
 
 
 
-glm::vec2 getCollisionVector(Sprite& sprite1, Sprite& sprite2){
-	float x = sprite1.pos.x - sprite1.pos.x;
-	float y = sprite1.pos.y - sprite1.pos.y;
-
-	return glm::vec2();
-}
-
-bool collision(Sprite& sprite1, Sprite& sprite2){
-	Rectangle box1 = sprite1.getBoundingBox();
-	Rectangle box2 = sprite2.getBoundingBox();
-
-	if (box1.bottom > box2.top) return false;
-	if (box1.top < box2.bottom) return false;
-	if (box1.right < box2.left) return false;
-	if (box1.left > box2.right) return false;
-
-	return true;
-
-}
-
-glm::vec2& getBallVelocity(glm::vec2& pos, glm::vec2& velocity ){
-
-	float xsize = ball_size;	
-	float ysize = ball_size;
-
-	if ((pos.x - xsize) < -1) {
-		//std::cout << "Pos x: " << pos.x << " Negative Collision" << std::endl;
-		//pos.x = -1 + xsize; // may want to comment out?
-		velocity.x *= -1;
-		
-	}
-
-	if ((pos.x + xsize) > 1) {
-		//std::cout << "Pos x: " << pos.x << "Positive Collision" << std::endl;
-		//pos.x = 1 - xsize; // may want to comment out?
-		velocity.x *=-1;
-		
-	}
-
-
-	if ((pos.y - ysize) < -1) {
-		//std::cout << "Pos x: " << pos.x << " Negative Collision" << std::endl;
-		//pos.x = -1 + xsize; // may want to comment out?
-		velocity.y *= -1;
-
-	}
-
-	if ((pos.y + ysize) > 1) {
-		//std::cout << "Pos x: " << pos.x << "Positive Collision" << std::endl;
-		//pos.x = 1 - xsize; // may want to comment out?
-		velocity.y *= -1;
-
-	}
-
-	return velocity;
-}
-
-glm::vec2 getPosFromControls(GLFWwindow* window , double deltaTime, SQUARE square){
-	double xpos = 0;
-	double ypos = 0;
 
+std::uint8_t getInputFromControls(GLFWwindow* window, SQUARE square){
 	int upKey = GLFW_KEY_UP, downKey = GLFW_KEY_DOWN, leftKey = GLFW_KEY_LEFT, rightKey = GLFW_KEY_RIGHT;
 
 	switch (square){
@@ -782,78 +367,51 @@ glm::vec2 getPosFromControls(GLFWwindow* window , double deltaTime, SQUARE squar
 	
 	}
 
-	glm::vec2 pos(0.0f, 0.0f);
+	std::uint8_t input = 0;
 
-	// Move forward
 	if (glfwGetKey(window, upKey) == GLFW_PRESS)
-		pos.y += 1;
+		input |= INPUT_UP;
 	if (glfwGetKey(window, downKey) == GLFW_PRESS)
-		pos.y -= 1;
+		input |= INPUT_DOWN;
 	if (glfwGetKey(window, leftKey) == GLFW_PRESS)
-		pos.x -= 1;
+		input |= INPUT_LEFT;
 	if (glfwGetKey(window, rightKey) == GLFW_PRESS)
-		pos.x += 1;
-	
-	if (glm::length(pos))
-		glm::normalize(pos);
-	
-	pos *= (deltaTime * speed);	
-
-	return pos;
+		input |= INPUT_RIGHT;
 
+	return input;
 }
 
-GLuint createShader(GLenum eShaderType, const std::string &strShaderFile)
-{
-	GLuint shader = glCreateShader(eShaderType);
-	const char *strFileData = strShaderFile.c_str();
-	glShaderSource(shader, 1, &strFileData, NULL);
-
-	glCompileShader(shader);
-
-	const char *strShaderType = NULL;
-	switch (eShaderType)
-	{
-		case GL_VERTEX_SHADER: strShaderType = "Vertex"; break;
-		case GL_GEOMETRY_SHADER: strShaderType = "Geometry"; break;
-		case GL_FRAGMENT_SHADER: strShaderType = "Fragment"; break;
-	}
-
-	GLint status;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-	if (status == GL_FALSE)
-	{
-		GLint infoLogLength;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-
-		GLchar *strInfoLog = new GLchar[infoLogLength + 1];
-		glGetShaderInfoLog(shader, infoLogLength, NULL, strInfoLog);
-
-	
+//Loopback peers with late input must end on the same state as a run that knew every input
+int runRollbackTest(){
+	const std::uint32_t ticks = 60 * 60;
+	const std::uint32_t history_window = 64;
+	//The lead case sends every other input ahead of the receiver and the rest a
+	//history window late, so early and late input share ring slots
+	const struct { std::uint32_t delay, lead; } cases[] = {
+		{ 0, 0 }, { 2, 0 }, { 8, 0 }, { 30, 0 }, { history_window + 2, 8 },
+	};
 
-		fprintf(stderr, "Compile failure in %s shader:\n%s\n", strShaderType, strInfoLog);
-		delete[] strInfoLog;
+	int failures = 0;
+	for (auto test : cases){
+		LoopbackResult result = runLoopback(ticks, test.delay, history_window, test.lead);
+		printf("delay %2u lead %u ticks: %s, %llu rollbacks, %llu resimulated ticks, %.0f resimulated ticks/ms\n",
+			test.delay, test.lead, result.in_sync ? "in sync" : "DESYNC",
+			(unsigned long long)result.stats.rollbacks,
+			(unsigned long long)result.stats.resimulated_ticks,
+			result.stats.resimulate_ms > 0.0 ? result.stats.resimulated_ticks / result.stats.resimulate_ms : 0.0);
+		if (!result.in_sync)
+			++failures;
 	}
-	else {
-		fprintf(stderr, "%s Shader Compile Succesful\n" , strShaderType );
-	}
-
-	return shader;
+	return failures ? 1 : 0;
 }
 
 
 
 
 
-void getGLVersionInfo(){
-
-	//glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 1);
-	//glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 
-	GLFWwindow* window = glfwCreateWindow(96, 96, "Get Version Info", NULL, NULL);
-
-	//window = glfwCreateWindow(200, 200, "Version", NULL, NULL);
+//Reads the context the demo already made, there is no probe window
+void getGLVersionInfo(GLFWwindow* window){
 
 	cout << "GL Load Succesful" << endl;
 	int api = 0, major = 1, minor = 0, revision;
@@ -863,9 +421,6 @@ void getGLVersionInfo(){
 	minor = glfwGetWindowAttrib(window, GLFW_CONTEXT_VERSION_MINOR);
 	revision = glfwGetWindowAttrib(window, GLFW_CONTEXT_REVISION);
 
-	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
-	glfwMakeContextCurrent(window);
-
 	std::string  api_string = (api == GLFW_OPENGL_API) ? "OpenGl" : "OpenGL ES";
 
 	printf("%s context version string: \"%s\"\n",
@@ -891,12 +446,4 @@ void getGLVersionInfo(){
 			glGetString(GL_SHADING_LANGUAGE_VERSION));
 	}
 
-
-	glfwSetWindowShouldClose(window, true);
-	glfwDestroyWindow(window);
-	glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
-
 }
-
-
-
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+struct Rectangle {
+	Rectangle(float left, float top, float  right, float bottom) :
+	left(left), right(right), top(top), bottom(bottom)	{}
+	float left;
+	float right;
+	float top;
+	float bottom;
+};
+
+//How a sprite responds to contacts, combined per pair by the solver
+struct PhysicsMaterial {
+	float restitution = 0.0f; // 0 stops along the normal, 1 bounces back at full speed
+	float friction = 0.5f; // tangent impulse limit as a fraction of the normal impulse
+};
+
+
+struct Sprite {
+	Sprite(glm::vec2 size_in, glm::vec2 pos_in) : size(size_in), pos(pos_in)  {
+	}
+	Sprite() {
+	}
+	void setPos(float x , float y){
+		pos.x = x;
+		pos.y = y;
+		update();
+	}
+	void adjustPos(glm::vec2 pos){
+		this->pos += pos;
+		update();
+	}
+	void setSize(float x, float y){
+		size.x = x;
+		size.y = y;
+		update();
+	}
+	void setSize(glm::vec2 size){
+		this->size = size;
+		update();
+	}
+	void update(){
+		world_transform = glm::translate(glm::vec3(pos, 0.0f)) * glm::scale(glm::vec3(size, 1.0f));
+	}
+	glm::mat4& getWorldTransform(){
+		return world_transform;
+	}
+	const glm::mat4& getWorldTransform() const {
+		return world_transform;
+	}
+	void setVelocity(float x, float y){
+		velocity.x = x;
+		velocity.y = y;
+	}
+
+
+	Rectangle getBoundingBox(){
+		float left, right, top, bottom;
+		left = pos.x - size.x;
+		right = pos.x + size.x;
+		top = pos.y + size.y;
+		bottom = pos.y - size.y;
+
+		return Rectangle(left, top, right, bottom);
+	}
+
+
+	glm::vec2 velocity{ 0.15f, 0.15f };
+	glm::vec2 size{0.15f,0.15f};
+	glm::vec2 pos{ 0.0f , 0.0f };
+	PhysicsMaterial material;
+	float depth = 0.5f; // 0 is nearest, 1 farthest, sprites are drawn back to front
+	glm::mat4 world_transform;
+};
@@ -0,0 +1,234 @@
+#include "TextOverlay.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <memory>
+
+#include <glm/gtx/transform.hpp>
+
+#include "Bitmap.h"
+
+//TextVertexLayout, position, color then texture coordinate
+const unsigned text_vertex_floats = 8;
+const unsigned text_glyph_floats = 4 * text_vertex_floats;
+const std::size_t text_buffer_size = std::size_t(text_max_glyphs) * text_glyph_floats * sizeof(GLfloat);
+
+static_assert(text_max_glyphs * 4 <= 65536, "text vertices are indexed with GLushort");
+
+//Symbols after 0-9 and A-Z in text.bmp, cell 40 is a copyright sign
+const unsigned glyph_cell_minus = 41;
+const unsigned glyph_cell_times = 42;
+const unsigned glyph_cell_plus = 43;
+const unsigned glyph_cell_exclamation = 44;
+
+
+bool createGlyphAtlas(const std::string& image_path, GlyphAtlas& atlas){
+	unsigned int width{ 0 }, height{ 0 };
+	std::unique_ptr<unsigned char[]> data(load_bmp(image_path, width, height));
+	if (!data || width < 8 * glyph_size || height < 6 * glyph_size)
+		return false;
+
+	//White glyphs on black, keep the shape in alpha and let the vertex color tint it
+	std::vector<unsigned char> rgba(std::size_t(width) * height * 4);
+	for (std::size_t i = 0; i < std::size_t(width) * height; ++i){
+		unsigned brightness = data[i * 3] + data[i * 3 + 1] + data[i * 3 + 2];
+		unsigned char alpha = brightness > 3 * 128 ? 255 : 0;
+		rgba[i * 4] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = 255;
+		rgba[i * 4 + 3] = alpha;
+	}
+
+	atlas.texture = makeTexture("glyph atlas");
+	glBindTexture(GL_TEXTURE_2D, atlas.texture.get());
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+	atlas.texture.setBytes(textureBytes(width, height, 4));
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	const unsigned columns = width / glyph_size;
+
+	//Rows top..top + rows of the cell, cells are counted from the top left
+	auto cell = [&](unsigned index, unsigned top, unsigned rows){
+		float x = float(index % columns * glyph_size), y = float(index / columns * glyph_size + top);
+		Glyph glyph;
+		glyph.uv = glm::vec4(x / width, 1.0f - (y + rows) / height,
+			(x + glyph_size) / width, 1.0f - y / height);
+		glyph.top = float(top);
+		glyph.height = float(rows);
+		return glyph;
+	};
+
+	atlas.glyphs.fill(Glyph());
+	for (unsigned digit = 0; digit < 10; ++digit)
+		atlas.glyphs['0' + digit] = cell(digit, 0, glyph_size);
+	for (unsigned letter = 0; letter < 26; ++letter)
+		atlas.glyphs['A' + letter] = cell(10 + letter, 0, glyph_size);
+	atlas.glyphs['-'] = cell(glyph_cell_minus, 0, glyph_size);
+	atlas.glyphs['*'] = cell(glyph_cell_times, 0, glyph_size);
+	atlas.glyphs['+'] = cell(glyph_cell_plus, 0, glyph_size);
+	atlas.glyphs['!'] = cell(glyph_cell_exclamation, 0, glyph_size);
+	//No period in the sheet, the dot under the exclamation mark stands in
+	atlas.glyphs['.'] = cell(glyph_cell_exclamation, 6, 2);
+	return true;
+}
+
+
+TextOverlay::TextOverlay(const GlyphAtlas& atlas, unsigned scale) :
+	atlas(atlas), scale(float(std::max(scale, 1u))) {
+
+	program.build("text program");
+	program.use();
+	program.set<TextureSampler>(0);
+
+	indexBuffer = createQuadIndexBuffer(text_max_glyphs);
+
+	staticBuffer = makeBuffer("static text");
+	staticVAO = createTextArray(staticBuffer);
+
+	dynamicBuffer = makeBuffer("dynamic text");
+	glBindBuffer(GL_ARRAY_BUFFER, dynamicBuffer.get());
+	bufferData(dynamicBuffer, GL_ARRAY_BUFFER, text_buffer_size, nullptr, GL_STREAM_DRAW);
+	dynamicVAO = createTextArray(dynamicBuffer);
+
+	dynamicVertices.reserve(std::size_t(text_max_glyphs) * text_glyph_floats);
+}
+
+VertexArrayHandle TextOverlay::createTextArray(const BufferHandle& buffer){
+	VertexArrayHandle vao = createVertexArray<TextVertexLayout>(buffer);
+	glBindVertexArray(vao.get());
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.get());
+	glBindVertexArray(0);
+	return vao;
+}
+
+void TextOverlay::setScreenSize(int width, int height){
+	//Pixels from the top left to clip space
+	screen = glm::translate(glm::vec3(-1.0f, 1.0f, 0.0f)) *
+		glm::scale(glm::vec3(2.0f / std::max(width, 1), -2.0f / std::max(height, 1), 1.0f));
+}
+
+unsigned TextOverlay::appendText(std::vector<GLfloat>& vertices, glm::vec2 pos, const char* text, glm::vec3 color){
+	const float advance = glyph_size * scale;
+
+	unsigned dropped = 0;
+	glm::vec2 cursor = pos;
+	for (const char* c = text; *c; ++c){
+		if (*c == '\n'){
+			cursor = glm::vec2(pos.x, cursor.y + getLineHeight());
+			continue;
+		}
+
+		unsigned char code = (unsigned char)std::toupper((unsigned char)*c);
+		const Glyph& glyph = code < atlas.glyphs.size() ? atlas.glyphs[code] : atlas.glyphs[' '];
+		if (glyph.height > 0.0f){
+			if (vertices.size() >= std::size_t(text_max_glyphs) * text_glyph_floats){
+				++dropped;
+			}
+			else {
+				float x0 = cursor.x, x1 = cursor.x + advance;
+				float y0 = cursor.y + glyph.top * scale, y1 = y0 + glyph.height * scale;
+				const GLfloat quad[text_glyph_floats] = {
+					x0, y1, 0.0f,  color.x, color.y, color.z,  glyph.uv.x, glyph.uv.y,
+					x1, y1, 0.0f,  color.x, color.y, color.z,  glyph.uv.z, glyph.uv.y,
+					x1, y0, 0.0f,  color.x, color.y, color.z,  glyph.uv.z, glyph.uv.w,
+					x0, y0, 0.0f,  color.x, color.y, color.z,  glyph.uv.x, glyph.uv.w,
+				};
+				vertices.insert(vertices.end(), quad, quad + text_glyph_floats);
+			}
+		}
+		cursor.x += advance;
+	}
+	return dropped;
+}
+
+void TextOverlay::addStaticText(glm::vec2 pos, const char* text, glm::vec3 color){
+	appendText(staticVertices, pos, text, color);
+	staticDirty = true;
+}
+
+void TextOverlay::clearStaticText(){
+	staticVertices.clear();
+	staticDirty = true;
+}
+
+void TextOverlay::print(glm::vec2 pos, const char* text, glm::vec3 color){
+	auto start = std::chrono::steady_clock::now();
+	pending_dropped += appendText(dynamicVertices, pos, text, color);
+	pending_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void TextOverlay::draw(){
+	auto start = std::chrono::steady_clock::now();
+
+	const GLsizei static_glyphs = GLsizei(staticVertices.size() / text_glyph_floats);
+	const GLsizei dynamic_glyphs = GLsizei(dynamicVertices.size() / text_glyph_floats);
+
+	//Static text only goes over the bus when it changed
+	if (staticDirty){
+		glBindBuffer(GL_ARRAY_BUFFER, staticBuffer.get());
+		bufferData(staticBuffer, GL_ARRAY_BUFFER, staticVertices.size() * sizeof(GLfloat), staticVertices.data(), GL_STATIC_DRAW);
+		staticDirty = false;
+	}
+
+	stats.draw_calls = 0;
+	if (static_glyphs || dynamic_glyphs){
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		program.use();
+		program.set<WorldSpace>(screen);
+		glBindTexture(GL_TEXTURE_2D, atlas.texture.get());
+
+		if (static_glyphs){
+			glBindVertexArray(staticVAO.get());
+			glDrawElements(GL_TRIANGLES, static_glyphs * 6, GL_UNSIGNED_SHORT, nullptr);
+			++stats.draw_calls;
+		}
+
+		if (dynamic_glyphs){
+			//Orphan last frame's storage so the upload never waits on the GPU
+			glBindBuffer(GL_ARRAY_BUFFER, dynamicBuffer.get());
+			glBufferData(GL_ARRAY_BUFFER, text_buffer_size, nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, dynamicVertices.size() * sizeof(GLfloat), dynamicVertices.data());
+
+			glBindVertexArray(dynamicVAO.get());
+			glDrawElements(GL_TRIANGLES, dynamic_glyphs * 6, GL_UNSIGNED_SHORT, nullptr);
+			++stats.draw_calls;
+		}
+
+		glBindVertexArray(0);
+		glDisable(GL_BLEND);
+	}
+	dynamicVertices.clear();
+
+	double ms = pending_ms + std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stats.glyphs = unsigned(static_glyphs + dynamic_glyphs);
+	stats.dropped_glyphs = pending_dropped;
+	stats.cpu_ms = float(ms);
+	++stats.frames;
+	if (stats.cpu_ms > text_overlay_budget_ms)
+		++stats.frames_over_budget;
+
+	pending_ms = 0.0;
+	pending_dropped = 0;
+}
+
+
+void FrameTimer::tick(float deltaTime){
+	elapsed += deltaTime;
+	++frames;
+	worst = std::max(worst, deltaTime);
+
+	if (elapsed >= window){
+		fps = frames / elapsed;
+		frame_ms = 1000.0f * elapsed / frames;
+		worst_ms = 1000.0f * worst;
+
+		elapsed = 0.0f;
+		frames = 0;
+		worst = 0.0f;
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "Pipeline.h"
+#include "Resources.h"
+
+/*
+Description
+
+On screen text for live stats, drawn with the bitmap font in text.bmp
+
+text.bmp is a 64 x 64 sheet of 8 x 8 glyphs: 0-9, A-Z, then a few symbols.
+It is turned into an alpha tested RGBA texture once and every character maps
+to a rect in it, lower case prints as upper case and characters the sheet
+does not have print as blanks.
+
+Static text such as the labels is baked into its own buffer when it changes.
+Everything printed during a frame goes into one dynamic buffer that is
+orphaned and refilled by draw, so the overlay costs two draw calls at most.
+The glyphs per frame are capped and the CPU time is checked against
+text_overlay_budget_ms so it can stay on while profiling.
+
+*/
+
+const unsigned glyph_size = 8; // texels per glyph side in text.bmp
+const unsigned text_max_glyphs = 4096; // per buffer, text past this is dropped
+const float text_overlay_budget_ms = 0.25f; // CPU time for print and draw per frame
+
+typedef PipelineDesc<FEATURE_COLOR | FEATURE_TEXTURE, TextVertexLayout> TextPipeline;
+
+struct Glyph {
+	glm::vec4 uv{ 0.0f }; // u0, v0 (bottom), u1, v1 (top)
+	float top = 0.0f; // texels from the top of the cell to the first row of the glyph
+	float height = 0.0f; // texels, 0 for a blank
+};
+
+struct GlyphAtlas {
+	TextureHandle texture;
+	std::array<Glyph, 128> glyphs;
+};
+
+//Builds the glyph table and the RGBA texture from a sheet laid out like text.bmp
+bool createGlyphAtlas(const std::string& image_path, GlyphAtlas& atlas);
+
+struct TextOverlayStats {
+	unsigned glyphs = 0; // static and dynamic glyphs drawn last frame
+	unsigned draw_calls = 0;
+	unsigned dropped_glyphs = 0; // over text_max_glyphs
+	float cpu_ms = 0.0f; // print and draw last frame
+	unsigned frames_over_budget = 0;
+	unsigned frames = 0;
+};
+
+
+//Keeps a reference to the glyph atlas, it has to outlive the overlay
+class TextOverlay {
+public:
+	explicit TextOverlay(const GlyphAtlas& atlas, unsigned scale = 2);
+
+	TextOverlay(const TextOverlay&) = delete;
+	TextOverlay& operator=(const TextOverlay&) = delete;
+
+	//Framebuffer size in pixels, text positions are pixels from the top left
+	void setScreenSize(int width, int height);
+
+	//Baked once and drawn every frame until clearStaticText
+	void addStaticText(glm::vec2 pos, const char* text, glm::vec3 color = glm::vec3(1.0f));
+	void clearStaticText();
+
+	//Drawn by the next draw only
+	void print(glm::vec2 pos, const char* text, glm::vec3 color = glm::vec3(1.0f));
+
+	//Blends the static and this frame's text over the framebuffer
+	void draw();
+
+	float getLineHeight() const { return float((glyph_size + 2) * scale); }
+	const TextOverlayStats& getStats() const { return stats; }
+
+private:
+	unsigned appendText(std::vector<GLfloat>& vertices, glm::vec2 pos, const char* text, glm::vec3 color);
+	VertexArrayHandle createTextArray(const BufferHandle& buffer);
+
+	const GlyphAtlas& atlas;
+	float scale;
+	glm::mat4 screen{ 1.0f };
+
+	Program<TextPipeline> program;
+	BufferHandle indexBuffer;
+
+	std::vector<GLfloat> staticVertices;
+	BufferHandle staticBuffer;
+	VertexArrayHandle staticVAO;
+	bool staticDirty = false;
+
+	std::vector<GLfloat> dynamicVertices;
+	BufferHandle dynamicBuffer;
+	VertexArrayHandle dynamicVAO;
+
+	double pending_ms = 0.0; // print time since the last draw
+	unsigned pending_dropped = 0;
+	TextOverlayStats stats;
+};
+
+
+//Frame rate and frame time averaged over a short window so the numbers are readable
+class FrameTimer {
+public:
+	explicit FrameTimer(float window = 0.5f) : window(window) {}
+
+	void tick(float deltaTime);
+
+	float getFps() const { return fps; }
+	float getFrameMs() const { return frame_ms; }
+	float getWorstMs() const { return worst_ms; }
+
+private:
+	float window;
+	float elapsed = 0.0f;
+	unsigned frames = 0;
+	float worst = 0.0f;
+
+	float fps = 0.0f;
+	float frame_ms = 0.0f;
+	float worst_ms = 0.0f;
+};
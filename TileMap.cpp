@@ -0,0 +1,238 @@
+#include "TileMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+
+#include <glm/gtx/transform.hpp>
+
+#include "Bitmap.h"
+
+//TextureVertexLayout, position then texture coordinate
+const unsigned tile_vertex_floats = 5;
+
+static_assert(tile_chunk_tiles * 4 <= 65536, "chunk vertices are indexed with GLushort");
+
+
+bool createTileSet(const std::string& image_path, unsigned columns, unsigned rows, TileSet& tileset){
+	unsigned int width{ 0 }, height{ 0 };
+	std::unique_ptr<unsigned char[]> data(load_bmp(image_path, width, height));
+	if (!data || columns == 0 || rows == 0)
+		return false;
+
+	tileset.texture = createBmpTexture(data.get(), width, height, "tile set");
+	tileset.width = width;
+	tileset.height = height;
+	tileset.columns = columns;
+	tileset.rows = rows;
+	return true;
+}
+
+
+TileMap::TileMap(unsigned width, unsigned height, const TileSet& tileset, std::size_t cache_chunks) :
+	width(width), height(height),
+	chunks_x((width + tile_chunk_size - 1) / tile_chunk_size),
+	chunks_y((height + tile_chunk_size - 1) / tile_chunk_size),
+	tileset(tileset),
+	tiles(std::size_t(width) * height, 0),
+	tiles_memory("tile map", tiles.size() * sizeof(TileIndex)),
+	resident(std::size_t(chunks_x) * chunks_y, -1),
+	cache_capacity(std::max<std::size_t>(cache_chunks, 1)) {
+
+	indexBuffer = createQuadIndexBuffer(tile_chunk_tiles);
+
+	cache.reserve(cache_capacity);
+	scratch.reserve(tile_chunk_tiles * 4 * tile_vertex_floats);
+}
+
+void TileMap::setTile(unsigned x, unsigned y, TileIndex tile){
+	TileIndex& current = tiles[std::size_t(y) * width + x];
+	if (current == tile)
+		return;
+	current = tile;
+
+	std::int32_t slot = resident[(y / tile_chunk_size) * chunks_x + x / tile_chunk_size];
+	if (slot >= 0)
+		cache[slot].dirty = true;
+}
+
+unsigned TileMap::buildChunkVertices(unsigned chunk_x, unsigned chunk_y, std::vector<GLfloat>& vertices) const {
+	vertices.clear();
+
+	const unsigned x0 = chunk_x * tile_chunk_size, y0 = chunk_y * tile_chunk_size;
+	const unsigned x1 = std::min(x0 + tile_chunk_size, width), y1 = std::min(y0 + tile_chunk_size, height);
+
+	//Half a texel in from the cell edges so neighbouring cells never bleed in
+	const float cell_u = 1.0f / tileset.columns, cell_v = 1.0f / tileset.rows;
+	const float inset_u = tileset.width ? 0.5f / tileset.width : 0.0f;
+	const float inset_v = tileset.height ? 0.5f / tileset.height : 0.0f;
+
+	unsigned count = 0;
+	for (unsigned y = y0; y < y1; ++y){
+		for (unsigned x = x0; x < x1; ++x){
+			TileIndex tile = getTile(x, y);
+			if (tile == 0 || tile > tileset.size())
+				continue;
+
+			unsigned cell = tile - 1u;
+			float u0 = (cell % tileset.columns) * cell_u + inset_u;
+			float u1 = (cell % tileset.columns + 1) * cell_u - inset_u;
+			//load_bmp rows are bottom up, v = 1 is the top of the sheet
+			float v1 = 1.0f - (cell / tileset.columns) * cell_v - inset_v;
+			float v0 = 1.0f - (cell / tileset.columns + 1) * cell_v + inset_v;
+
+			float px = float(x - x0), py = float(y - y0);
+			const GLfloat quad[4 * tile_vertex_floats] = {
+				px, py, 0.0f,                u0, v0,
+				px + 1.0f, py, 0.0f,         u1, v0,
+				px + 1.0f, py + 1.0f, 0.0f,  u1, v1,
+				px, py + 1.0f, 0.0f,         u0, v1,
+			};
+			vertices.insert(vertices.end(), quad, quad + 4 * tile_vertex_floats);
+			++count;
+		}
+	}
+	return count;
+}
+
+TileMap::CachedChunk& TileMap::acquire(std::uint32_t chunk){
+	if (resident[chunk] >= 0)
+		return cache[resident[chunk]];
+
+	//Reuse the least recently drawn slot, but never one already drawn this frame
+	std::size_t slot = cache.size();
+	if (cache.size() >= cache_capacity){
+		std::uint64_t oldest = frame;
+		for (std::size_t i = 0; i < cache.size(); ++i){
+			if (cache[i].last_drawn < oldest){
+				oldest = cache[i].last_drawn;
+				slot = i;
+			}
+		}
+	}
+
+	//Every slot is on screen, grow past the capacity rather than leave a hole.
+	//trim gives the extra slots back once they are off screen again.
+	if (slot == cache.size()){
+		CachedChunk created;
+		created.buffer = makeBuffer("tile chunk");
+		created.vao = createVertexArray<TextureVertexLayout>(created.buffer);
+		glBindVertexArray(created.vao.get());
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.get());
+		glBindVertexArray(0);
+
+		cache.push_back(std::move(created));
+	}
+
+	CachedChunk& cached = cache[slot];
+	if (cached.chunk != UINT32_MAX)
+		resident[cached.chunk] = -1;
+	cached.chunk = chunk;
+	cached.dirty = true;
+	resident[chunk] = std::int32_t(slot);
+	return cached;
+}
+
+void TileMap::bake(CachedChunk& cached){
+	unsigned count = buildChunkVertices(cached.chunk % chunks_x, cached.chunk / chunks_x, scratch);
+
+	//Sized to the tiles the chunk has, an empty chunk keeps no storage
+	glBindBuffer(GL_ARRAY_BUFFER, cached.buffer.get());
+	bufferData(cached.buffer, GL_ARRAY_BUFFER, scratch.size() * sizeof(GLfloat), count ? scratch.data() : nullptr,
+		GL_STATIC_DRAW);
+	cached.index_count = GLsizei(count * 6);
+	cached.dirty = false;
+	++stats.baked_chunks;
+}
+
+void TileMap::draw(const Program<TexturePipeline>& program, const Camera2D& camera){
+	++frame;
+	stats = TileMapStats();
+
+	//Chunks overlapping the camera rectangle, clamped to the map
+	glm::vec2 low = glm::floor((camera.center - camera.half_extent) / float(tile_chunk_size));
+	glm::vec2 high = glm::floor((camera.center + camera.half_extent) / float(tile_chunk_size));
+	if (high.x < 0.0f || high.y < 0.0f || low.x >= float(chunks_x) || low.y >= float(chunks_y)){
+		trim();
+		stats.cached_chunks = cache.size();
+		return;
+	}
+	unsigned cx0 = unsigned(std::max(low.x, 0.0f)), cy0 = unsigned(std::max(low.y, 0.0f));
+	unsigned cx1 = std::min(unsigned(high.x), chunks_x - 1), cy1 = std::min(unsigned(high.y), chunks_y - 1);
+
+	const glm::mat4 view = camera.getViewTransform();
+
+	program.use();
+	glBindTexture(GL_TEXTURE_2D, tileset.texture.get());
+
+	for (unsigned cy = cy0; cy <= cy1; ++cy){
+		for (unsigned cx = cx0; cx <= cx1; ++cx){
+			++stats.visible_chunks;
+
+			CachedChunk& cached = acquire(cy * chunks_x + cx);
+			if (cached.dirty)
+				bake(cached);
+			cached.last_drawn = frame;
+			if (cached.index_count == 0)
+				continue;
+
+			glm::vec3 origin(float(cx * tile_chunk_size), float(cy * tile_chunk_size), 0.0f);
+			program.set<WorldSpace>(view * glm::translate(origin));
+			glBindVertexArray(cached.vao.get());
+			glDrawElements(GL_TRIANGLES, cached.index_count, GL_UNSIGNED_SHORT, nullptr);
+			++stats.draw_calls;
+		}
+	}
+
+	glBindVertexArray(0);
+	trim();
+	stats.cached_chunks = cache.size();
+}
+
+void TileMap::trim(){
+	//Drop slots not drawn this frame until the cache is back to its capacity
+	for (std::size_t i = 0; cache.size() > cache_capacity && i < cache.size();){
+		if (cache[i].last_drawn == frame){
+			++i;
+			continue;
+		}
+		if (cache[i].chunk != UINT32_MAX)
+			resident[cache[i].chunk] = -1;
+		if (i + 1 != cache.size()){
+			cache[i] = std::move(cache.back());
+			if (cache[i].chunk != UINT32_MAX)
+				resident[cache[i].chunk] = std::int32_t(i);
+		}
+		cache.pop_back();
+	}
+}
+
+
+static std::uint32_t tileHash(std::uint32_t x, std::uint32_t y, std::uint32_t seed){
+	std::uint32_t hash = x * 0x8DA6B343u ^ y * 0xD8163841u ^ seed * 0xCB1AB31Fu;
+	hash ^= hash >> 13;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+void generateTileMap(TileMap& map, std::uint32_t seed){
+	const unsigned patch = 8; // tiles per patch side
+	const unsigned cells = map.getTileSet().size();
+
+	for (unsigned y = 0; y < map.getHeight(); ++y){
+		for (unsigned x = 0; x < map.getWidth(); ++x){
+			std::uint32_t kind = tileHash(x / patch, y / patch, seed);
+			TileIndex tile = 0;
+
+			//A quarter of the patches are gaps, the rest are one tile with some scattered detail
+			if (kind % 4 != 0){
+				std::uint32_t detail = tileHash(x, y, seed);
+				std::uint32_t cell = (detail % 16 == 0 ? detail >> 8 : kind >> 8) % cells;
+				tile = TileIndex(cell + 1);
+			}
+			map.setTile(x, y, tile);
+		}
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "Resources.h"
+#include "Scene.h"
+
+/*
+Description
+
+Tile map levels drawn from the sprite BMPs
+
+The map is split into square chunks.  A chunk is baked into its own vertex
+buffer the first time it becomes visible and is then redrawn with a single
+glDrawElements until a setTile inside it marks it dirty.  Only the chunks
+overlapping the camera are submitted, so the cost of a frame depends on the
+screen size and not on the size of the level.
+
+A 4096 x 4096 map has 16384 chunks, far more than should live in VRAM, so
+baked chunks are kept in a fixed cache and the least recently drawn one is
+reused when a new chunk scrolls into view.  A view wider than the cache grows
+it for as long as it lasts, and each buffer only holds the tiles its chunk has.
+
+*/
+
+const unsigned tile_chunk_size = 32; // tiles per chunk side
+const unsigned tile_chunk_tiles = tile_chunk_size * tile_chunk_size;
+const std::size_t tile_chunk_cache = 256; // baked chunks kept resident
+
+//0 is an empty tile, n is cell n - 1 of the tile set
+typedef std::uint16_t TileIndex;
+
+//A BMP sliced into a grid of tiles, cells are counted from the top left
+struct TileSet {
+	TextureHandle texture;
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned columns = 1;
+	unsigned rows = 1;
+
+	unsigned size() const { return columns * rows; }
+};
+
+//Same texture setup as the title, see createBmpTexture
+bool createTileSet(const std::string& image_path, unsigned columns, unsigned rows, TileSet& tileset);
+
+struct TileMapStats {
+	unsigned visible_chunks = 0;
+	unsigned draw_calls = 0; // visible chunks that are not empty
+	unsigned baked_chunks = 0; // rebuilt this frame
+	std::size_t cached_chunks = 0;
+};
+
+
+//Keeps a reference to the tile set, it has to outlive the map
+class TileMap {
+public:
+	TileMap(unsigned width, unsigned height, const TileSet& tileset, std::size_t cache_chunks = tile_chunk_cache);
+
+	TileMap(const TileMap&) = delete;
+	TileMap& operator=(const TileMap&) = delete;
+
+	TileIndex getTile(unsigned x, unsigned y) const { return tiles[std::size_t(y) * width + x]; }
+
+	//Marks the chunk dirty, it is rebaked the next time it is drawn
+	void setTile(unsigned x, unsigned y, TileIndex tile);
+
+	//Writes 4 TextureVertexLayout vertices per non empty tile, positions are
+	//relative to the chunk origin.  Returns the number of tiles written.
+	unsigned buildChunkVertices(unsigned chunk_x, unsigned chunk_y, std::vector<GLfloat>& vertices) const;
+
+	void draw(const Program<TexturePipeline>& program, const Camera2D& camera);
+
+	unsigned getWidth() const { return width; }
+	unsigned getHeight() const { return height; }
+	const TileSet& getTileSet() const { return tileset; }
+	const TileMapStats& getStats() const { return stats; }
+
+private:
+	struct CachedChunk {
+		BufferHandle buffer;
+		VertexArrayHandle vao;
+		std::uint32_t chunk = UINT32_MAX;
+		GLsizei index_count = 0;
+		bool dirty = false;
+		std::uint64_t last_drawn = 0;
+	};
+
+	CachedChunk& acquire(std::uint32_t chunk);
+	void bake(CachedChunk& cached);
+	void trim();
+
+	unsigned width;
+	unsigned height;
+	unsigned chunks_x;
+	unsigned chunks_y;
+	const TileSet& tileset;
+
+	std::vector<TileIndex> tiles;
+	HostMemory tiles_memory;
+	std::vector<std::int32_t> resident; // cache slot per chunk, -1 when not baked
+	std::vector<CachedChunk> cache;
+	std::size_t cache_capacity;
+
+	BufferHandle indexBuffer; // the same two triangles per tile for every chunk
+	std::vector<GLfloat> scratch;
+
+	std::uint64_t frame = 0;
+	TileMapStats stats;
+};
+
+//Deterministic terrain of patches and gaps for the demo and the benchmarks
+void generateTileMap(TileMap& map, std::uint32_t seed);
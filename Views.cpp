@@ -0,0 +1,120 @@
+#include "Views.h"
+
+#include <chrono>
+
+static float millisecondsSince(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+ViewRenderer::ViewRenderer(GLFWwindow* main_window, const SceneResources& scene, WorkerPool& pool) :
+	main_window(main_window), scene(scene), pool(pool) {
+	targets.push_back({ main_window, SceneContext() });
+}
+
+ViewRenderer::~ViewRenderer(){
+	//Vertex arrays belong to the context that made them
+	for (Target& target : targets){
+		if (target.window == main_window)
+			continue;
+		glfwMakeContextCurrent(target.window);
+		target.context = SceneContext();
+		glfwDestroyWindow(target.window);
+	}
+	glfwMakeContextCurrent(main_window);
+}
+
+GLFWwindow* ViewRenderer::addWindow(int width, int height, const char* title, bool visible){
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GL_TRUE : GL_FALSE);
+	GLFWwindow* window = glfwCreateWindow(width, height, title, NULL, main_window);
+	glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+	if (!window)
+		return nullptr;
+
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0); // only the main window waits for vsync
+	glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
+
+	Target target = { window, SceneContext() };
+	createSceneContext(scene, target.context);
+	targets.push_back(std::move(target));
+
+	glfwMakeContextCurrent(main_window);
+	return window;
+}
+
+std::size_t ViewRenderer::addView(GLFWwindow* window, glm::vec4 viewport){
+	std::size_t target = 0;
+	while (target < targets.size() && targets[target].window != window)
+		++target;
+	if (target == targets.size())
+		target = 0;
+
+	views.push_back({ target, viewport, Camera2D(), CommandList() });
+	return views.size() - 1;
+}
+
+const SceneContext& ViewRenderer::getContext(const Target& target) const {
+	return target.window == main_window ? scene.context : target.context;
+}
+
+void ViewRenderer::prepare(const SceneSprites* sprites, std::size_t count){
+	auto start = std::chrono::steady_clock::now();
+
+	//One task per view, the lists keep their capacity between frames and each is sorted on its own task
+	pool.run(views.size(), [&](std::size_t i){
+		views[i].commands.clear();
+		prepareScene(sprites, count, views[i].camera, views[i].commands);
+		views[i].commands.sort();
+	});
+
+	stats.views = views.size();
+	stats.prepare_ms = millisecondsSince(start);
+}
+
+unsigned ViewRenderer::submit(){
+	auto start = std::chrono::steady_clock::now();
+	unsigned draw_calls = 0;
+
+	for (std::size_t t = 0; t < targets.size(); ++t){
+		const Target& target = targets[t];
+		if (target.window != main_window){
+			glfwMakeContextCurrent(target.window);
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+
+		int width, height;
+		glfwGetFramebufferSize(target.window, &width, &height);
+
+		glEnable(GL_SCISSOR_TEST);
+		for (const View& view : views){
+			if (view.target != t)
+				continue;
+			GLint x = GLint(view.viewport.x * width), y = GLint(view.viewport.y * height);
+			GLsizei w = GLsizei(view.viewport.z * width), h = GLsizei(view.viewport.w * height);
+			glViewport(x, y, w, h);
+			glScissor(x, y, w, h);
+			draw_calls += submitCommands(scene, getContext(target), view.commands);
+		}
+		glDisable(GL_SCISSOR_TEST);
+		glViewport(0, 0, width, height);
+
+		//Hand the commands to the driver before switching contexts
+		if (target.window != main_window)
+			glFlush();
+	}
+	glfwMakeContextCurrent(main_window);
+
+	stats.draw_calls = draw_calls;
+	stats.submit_ms = millisecondsSince(start);
+	return draw_calls;
+}
+
+void ViewRenderer::present(){
+	for (const Target& target : targets)
+		if (target.window != main_window)
+			glfwSwapBuffers(target.window);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+#include "WorkerPool.h"
+
+/*
+Description
+
+Several cameras on the same scene, in viewports of the main window or of
+extra windows whose contexts share objects with it
+
+Buffers, textures and programs live in the share group and are created once,
+each extra window only gets the vertex arrays of its own SceneContext.
+
+A frame is prepared then submitted.  prepare builds the command list of every
+view on the worker pool, culling against that view's camera.  submit walks
+the windows on the calling thread, makes each context current in turn and
+draws its views with glViewport and glScissor, then leaves the main context
+current again.  The main window is not cleared by submit, the game has
+already drawn into it, the extra windows are.
+
+*/
+
+struct ViewStats {
+	std::size_t views = 0;
+	unsigned draw_calls = 0; // last frame, all views
+	float prepare_ms = 0.0f;
+	float submit_ms = 0.0f;
+};
+
+
+//Keeps references to the scene and the pool, both have to outlive it
+class ViewRenderer {
+public:
+	ViewRenderer(GLFWwindow* main_window, const SceneResources& scene, WorkerPool& pool);
+	~ViewRenderer();
+
+	ViewRenderer(const ViewRenderer&) = delete;
+	ViewRenderer& operator=(const ViewRenderer&) = delete;
+
+	//A window sharing the main context, nullptr when it could not be created
+	GLFWwindow* addWindow(int width, int height, const char* title, bool visible = true);
+
+	//viewport is x, y, width, height as fractions of the window framebuffer
+	std::size_t addView(GLFWwindow* window, glm::vec4 viewport);
+
+	Camera2D& getCamera(std::size_t view) { return views[view].camera; }
+	std::size_t getViewCount() const { return views.size(); }
+
+	//Safe to call while nothing is submitting, the sprites are only read
+	void prepare(const SceneSprites* sprites, std::size_t count);
+
+	//Returns the number of draw calls, needs the main context current
+	unsigned submit();
+
+	//Swaps the extra windows, the main window is swapped by its owner
+	void present();
+
+	const ViewStats& getStats() const { return stats; }
+
+private:
+	struct Target {
+		GLFWwindow* window;
+		SceneContext context; // empty for the main window, it uses the scene's
+	};
+
+	struct View {
+		std::size_t target;
+		glm::vec4 viewport;
+		Camera2D camera;
+		CommandList commands;
+	};
+
+	const SceneContext& getContext(const Target& target) const;
+
+	GLFWwindow* main_window;
+	const SceneResources& scene;
+	WorkerPool& pool;
+
+	std::vector<Target> targets;
+	std::vector<View> views;
+	ViewStats stats;
+};
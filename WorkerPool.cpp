@@ -0,0 +1,81 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned threads){
+	if (threads == 0)
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned i = 1; i < threads; ++i)
+		workers.emplace_back(&WorkerPool::work, this);
+}
+
+WorkerPool::~WorkerPool(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void WorkerPool::run(std::size_t count, const std::function<void(std::size_t)>& function){
+	if (count == 0)
+		return;
+
+	//Not worth waking anyone
+	if (count == 1 || workers.empty()){
+		for (std::size_t task = 0; task < count; ++task)
+			function(task);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &function;
+		tasks = count;
+		next = 0;
+		pending = count;
+		active = unsigned(workers.size());
+		++generation;
+	}
+	wake.notify_all();
+
+	drain();
+
+	//Every worker has to leave drain before the next run can reset the counters
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]{ return pending == 0 && active == 0; });
+	job = nullptr;
+}
+
+void WorkerPool::drain(){
+	std::size_t task;
+	while ((task = next.fetch_add(1)) < tasks){
+		(*job)(task);
+		if (pending.fetch_sub(1) == 1){
+			std::lock_guard<std::mutex> lock(mutex);
+			done.notify_all();
+		}
+	}
+}
+
+void WorkerPool::work(){
+	unsigned long long seen = 0;
+	for (;;){
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]{ return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+		}
+
+		drain();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--active == 0)
+			done.notify_all();
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Description
+
+Persistent worker threads for per frame CPU work
+
+run hands out task indexes to the workers and the calling thread until all
+of them are done, so a frame can fan work out without creating threads.
+Jobs must not touch GL, only the thread that owns a context may do that.
+
+*/
+
+class WorkerPool {
+public:
+	//threads includes the caller, 0 uses one per hardware thread
+	explicit WorkerPool(unsigned threads = 0);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	unsigned size() const { return unsigned(workers.size()) + 1; }
+
+	//Calls job(task) for every task in [0, tasks), returns when all have finished
+	void run(std::size_t tasks, const std::function<void(std::size_t)>& job);
+
+private:
+	void work();
+	void drain();
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::function<void(std::size_t)>* job = nullptr;
+	std::size_t tasks = 0;
+	std::atomic<std::size_t> next{ 0 };
+	std::atomic<std::size_t> pending{ 0 };
+	unsigned active = 0; // workers still inside the current run
+	unsigned long long generation = 0;
+	bool stopping = false;
+};
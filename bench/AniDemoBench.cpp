@@ -0,0 +1,516 @@
+#include <algorithm>
+#include <random>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <GLFW/glfw3.h>
+
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+
+#include "Bitmap.h"
+#include "Collision.h"
+#include "DrawSort.h"
+#include "Particles.h"
+#include "Physics.h"
+#include "Scene.h"
+#include "Simulation.h"
+#include "TextOverlay.h"
+#include "TileMap.h"
+#include "Views.h"
+#include "WorkerPool.h"
+
+/*
+Description
+
+Benchmarks for the simulation and render loop
+
+The CPU benchmarks always run.  The GL benchmarks share one hidden 3.3 core
+window and are skipped when no context can be created.
+
+Run through the bench target to write bench_results.json, then bench_compare
+checks it against bench/baseline.json.
+
+*/
+
+using std::cout;
+using std::endl;
+
+static GLFWwindow* context = nullptr;
+static std::unique_ptr<SceneResources> scene;
+
+//load_bmp and createShader log every call, keep the benchmark output readable
+struct QuietCout {
+	QuietCout() { cout.setstate(std::ios::failbit); }
+	~QuietCout() { cout.clear(); }
+};
+
+static bool createHeadlessContext(){
+	if (!glfwInit())
+		return false;
+
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	context = glfwCreateWindow(1024, 768, "AniDemo Benchmark", NULL, NULL);
+	if (context == NULL)
+		return false;
+	glfwMakeContextCurrent(context);
+	glfwSwapInterval(0);
+
+	glewExperimental = true; // Needed for core profile
+	if (glewInit() != GLEW_OK){
+		glfwDestroyWindow(context);
+		context = nullptr;
+		return false;
+	}
+
+	scene.reset(new SceneResources);
+	if (!createSceneResources(*scene)){
+		scene.reset();
+		return false;
+	}
+
+	glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
+	return true;
+}
+
+
+static void BM_SpriteUpdate(benchmark::State& state){
+	std::vector<Sprite> sprites(state.range(0));
+	for (Sprite& sprite : sprites)
+		sprite.setSize(paddle_size, paddle_size);
+
+	const glm::vec2 step(0.001f, -0.001f);
+	for (auto _ : state){
+		for (Sprite& sprite : sprites)
+			sprite.adjustPos(step);
+		benchmark::DoNotOptimize(sprites.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SpriteUpdate)->RangeMultiplier(16)->Range(16, 1 << 16);
+
+static void BM_Collision(benchmark::State& state){
+	std::vector<Sprite> paddles(state.range(0));
+	for (std::size_t i = 0; i < paddles.size(); ++i){
+		paddles[i].setSize(paddle_size, paddle_size);
+		paddles[i].setPos(float(i % 64) / 32.0f - 1.0f, float(i / 64 % 64) / 32.0f - 1.0f);
+	}
+
+	Sprite ball;
+	ball.setSize(ball_size, ball_size);
+
+	for (auto _ : state){
+		int hits = 0;
+		for (Sprite& paddle : paddles){
+			if (collision(paddle, ball))
+				++hits;
+			getBallVelocity(ball.pos, ball.velocity);
+		}
+		benchmark::DoNotOptimize(hits);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Collision)->RangeMultiplier(16)->Range(16, 1 << 16);
+
+//A brick wall 20 high in a static bin, settled before timing so the contacts are warm.
+//Alternate rows are offset by half a box, so every box rests on two below and
+//touches its row neighbours, which takes several batches to color.
+static void BM_PhysicsSolve(benchmark::State& state){
+	const int boxes = int(state.range(0));
+	const int rows = 20;
+	const int columns = std::max(boxes / rows, 1);
+	const float width = columns + 0.5f;
+
+	WorkerPool pool;
+	PhysicsWorld world(pool);
+	world.reserve(std::size_t(boxes) + 3);
+	world.getSettings().gravity = glm::vec2(0.0f, -10.0f);
+	world.addBody(glm::vec2(width / 2.0f, -1.0f), glm::vec2(width / 2.0f + 2.0f, 1.0f), glm::vec2(0.0f), 0.0f);
+	world.addBody(glm::vec2(-1.0f, float(rows)), glm::vec2(1.0f, rows + 2.0f), glm::vec2(0.0f), 0.0f);
+	world.addBody(glm::vec2(width + 1.0f, float(rows)), glm::vec2(1.0f, rows + 2.0f), glm::vec2(0.0f), 0.0f);
+	for (int i = 0; i < boxes; ++i){
+		int row = i / columns;
+		world.addBody(glm::vec2(0.5f + (row % 2) * 0.5f + (i % columns), 0.5f + row), glm::vec2(0.5f), glm::vec2(0.0f), 1.0f);
+	}
+
+	for (int step = 0; step < 120; ++step)
+		world.step(sim_delta_time);
+
+	double solve_ms = 0.0, broadphase_ms = 0.0;
+	for (auto _ : state){
+		world.step(sim_delta_time);
+		solve_ms += world.getStats().solve_ms;
+		broadphase_ms += world.getStats().broadphase_ms;
+	}
+
+	float max_speed = 0.0f;
+	for (std::uint32_t body = 0; body < world.size(); ++body)
+		max_speed = std::max(max_speed, glm::length(world.getVelocity(body)));
+
+	const double iterations = double(state.iterations());
+	state.counters["solver_iterations_per_s"] = iterations * world.getSettings().iterations / (solve_ms / 1000.0);
+	state.counters["broadphase_ms"] = broadphase_ms / iterations;
+	state.counters["contacts"] = double(world.getStats().contacts);
+	state.counters["batches"] = double(world.getStats().batches);
+	state.counters["serial_contacts"] = double(world.getStats().serial_contacts);
+	state.counters["max_speed"] = max_speed; // a wide wall is still settling, this stays bounded
+	state.SetItemsProcessed(state.iterations() * boxes);
+}
+BENCHMARK(BM_PhysicsSolve)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_LoadBmp(benchmark::State& state){
+	QuietCout quiet;
+	unsigned int width{ 0 }, height{ 0 };
+	for (auto _ : state){
+		std::unique_ptr<unsigned char[]> data(load_bmp("Mario.bmp", width, height));
+		if (!data){
+			state.SkipWithError("Mario.bmp not found, run from the build directory");
+			break;
+		}
+		benchmark::DoNotOptimize(data.get());
+	}
+	state.SetBytesProcessed(state.iterations() * width * height * 3);
+}
+BENCHMARK(BM_LoadBmp);
+
+static void BM_ParticlesScalar(benchmark::State& state){
+	ParticleArrays particles;
+	particles.resize(state.range(0));
+	for (std::size_t i = 0; i < particles.x.size(); ++i){
+		particles.vx[i] = float(i % 200) / 100.0f - 1.0f;
+		particles.vy[i] = float(i % 150) / 75.0f - 1.0f;
+	}
+
+	for (auto _ : state)
+		updateParticlesScalar(particles, particles.x.size(), 1.0f / 60.0f);
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParticlesScalar)->Arg(1 << 20);
+
+static void BM_ParticlesSimd(benchmark::State& state){
+	ParticleArrays particles;
+	particles.resize(state.range(0));
+	for (std::size_t i = 0; i < particles.x.size(); ++i){
+		particles.vx[i] = float(i % 200) / 100.0f - 1.0f;
+		particles.vy[i] = float(i % 150) / 75.0f - 1.0f;
+	}
+
+	for (auto _ : state)
+		updateParticlesSimd(particles, particles.x.size(), 1.0f / 60.0f);
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParticlesSimd)->Arg(1 << 20);
+
+//Snapshot restore plus a replay of range(0) ticks, the cost of one worst case rollback
+static void BM_Resimulate(benchmark::State& state){
+	const std::uint32_t ticks = std::uint32_t(state.range(0));
+
+	std::vector<TickInput> inputs(ticks);
+	for (std::uint32_t i = 0; i < ticks; ++i)
+		inputs[i] = { { std::uint8_t(i / 7 % 16), std::uint8_t(i / 5 % 16) } };
+
+	SimState sim;
+	initSimState(sim);
+	SnapshotHistory history(ticks);
+	history.save(sim);
+
+	for (auto _ : state){
+		history.restore(0, sim);
+		for (const TickInput& input : inputs)
+			stepSimulation(sim, input);
+		benchmark::DoNotOptimize(hashState(sim));
+	}
+	state.counters["resim_ticks_per_ms"] = benchmark::Counter(
+		double(state.iterations()) * ticks / 1000.0, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Resimulate)->Arg(8)->Arg(64)->Arg(600);
+
+//Two peers with range(0) ticks of input delay, one minute of play per iteration
+static void BM_RollbackLoopback(benchmark::State& state){
+	double resimulated = 0.0;
+	for (auto _ : state){
+		LoopbackResult result = runLoopback(60 * 60, std::uint32_t(state.range(0)), 64);
+		if (!result.in_sync){
+			state.SkipWithError("loopback peers desynced");
+			break;
+		}
+		resimulated += double(result.stats.resimulated_ticks);
+	}
+	state.counters["resim_ticks_per_ms"] = benchmark::Counter(resimulated / 1000.0, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_RollbackLoopback)->Arg(2)->Arg(8)->Arg(30)->Unit(benchmark::kMillisecond);
+
+
+static void BM_ShaderCompileLink(benchmark::State& state){
+	if (!context){
+		state.SkipWithError("no GL 3.3 context");
+		return;
+	}
+
+	for (auto _ : state){
+		Program<AnimationPipeline> program;
+		program.build("animation program");
+		glFinish();
+	}
+}
+BENCHMARK(BM_ShaderCompileLink)->Unit(benchmark::kMillisecond);
+
+//N copies of the five sprite scene spread over the viewport
+static void BM_HeadlessFrame(benchmark::State& state){
+	if (!scene){
+		state.SkipWithError("no GL 3.3 context");
+		return;
+	}
+
+	std::vector<SceneSprites> scenes(state.range(0));
+	for (std::size_t i = 0; i < scenes.size(); ++i){
+		initSceneSprites(scenes[i]);
+		glm::vec2 offset(float(i % 17) / 8.0f - 1.0f, float(i / 17 % 17) / 8.0f - 1.0f);
+		scenes[i].paddle1.adjustPos(offset * 0.1f);
+		scenes[i].paddle2.adjustPos(offset * 0.1f);
+		scenes[i].ball.adjustPos(offset * 0.1f);
+		scenes[i].title.adjustPos(offset * 0.1f);
+		scenes[i].mario.adjustPos(offset * 0.1f);
+		scenes[i].animationIndex = GLuint(i % scene->frameCount);
+	}
+
+	for (auto _ : state){
+		glClear(GL_COLOR_BUFFER_BIT);
+		drawScene(*scene, scenes.data(), scenes.size());
+		glFinish();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * 5);
+}
+BENCHMARK(BM_HeadlessFrame)->RangeMultiplier(8)->Range(1, 1 << 12)->Unit(benchmark::kMicrosecond);
+
+//Rebuilding one full chunk, the cost a dirty or newly visible chunk adds to a frame
+static void BM_TileChunkBuild(benchmark::State& state){
+	if (!context){
+		state.SkipWithError("no GL 3.3 context");
+		return;
+	}
+
+	TileSet tileset;
+	tileset.columns = 10;
+	tileset.rows = 5;
+	TileMap map(tile_chunk_size, tile_chunk_size, tileset);
+	generateTileMap(map, 1);
+
+	std::vector<GLfloat> vertices;
+	for (auto _ : state){
+		benchmark::DoNotOptimize(map.buildChunkVertices(0, 0, vertices));
+		benchmark::DoNotOptimize(vertices.data());
+	}
+	state.SetItemsProcessed(state.iterations() * tile_chunk_tiles);
+}
+BENCHMARK(BM_TileChunkBuild);
+
+//4096 x 4096 level panned one tile per frame, range(0) tiles from the center to the screen edge
+static void BM_TileMapFrame(benchmark::State& state){
+	if (!scene){
+		state.SkipWithError("no GL 3.3 context");
+		return;
+	}
+
+	TileSet tileset;
+	{
+		QuietCout quiet;
+		if (!createTileSet("Mario.bmp", 10, 5, tileset)){
+			state.SkipWithError("Mario.bmp not found, run from the build directory");
+			return;
+		}
+	}
+	TileMap map(4096, 4096, tileset);
+	generateTileMap(map, 1);
+
+	Camera2D camera;
+	camera.center = glm::vec2(2048.0f);
+	camera.half_extent = glm::vec2(float(state.range(0)));
+
+	double visible = 0.0, draw_calls = 0.0, baked = 0.0;
+	for (auto _ : state){
+		camera.center.x += 1.0f;
+		glClear(GL_COLOR_BUFFER_BIT);
+		map.draw(scene->program_texture, camera);
+		glFinish();
+
+		visible += map.getStats().visible_chunks;
+		draw_calls += map.getStats().draw_calls;
+		baked += map.getStats().baked_chunks;
+	}
+
+	double frames = double(state.iterations());
+	state.counters["visible_chunks"] = visible / frames;
+	state.counters["draw_calls"] = draw_calls / frames;
+	state.counters["baked_per_frame"] = baked / frames;
+}
+BENCHMARK(BM_TileMapFrame)->Arg(16)->Arg(64)->Arg(256)->Unit(benchmark::kMicrosecond);
+
+//range(0) lines of live numbers under the static labels, the per frame cost of the stats overlay
+static void BM_TextOverlay(benchmark::State& state){
+	if (!context){
+		state.SkipWithError("no GL 3.3 context");
+		return;
+	}
+
+	GlyphAtlas font;
+	{
+		QuietCout quiet;
+		if (!createGlyphAtlas("text.bmp", font)){
+			state.SkipWithError("text.bmp not found, run from the build directory");
+			return;
+		}
+	}
+
+	TextOverlay overlay(font);
+	overlay.setScreenSize(1024, 768);
+	const int lines = int(state.range(0));
+	for (int i = 0; i < lines; ++i)
+		overlay.addStaticText(glm::vec2(8.0f, 8.0f + i * overlay.getLineHeight()), "FRAME MS");
+
+	char value[32];
+	float frame_ms = 16.0f;
+	for (auto _ : state){
+		for (int i = 0; i < lines; ++i){
+			snprintf(value, sizeof(value), "%.2f", frame_ms + i);
+			overlay.print(glm::vec2(200.0f, 8.0f + i * overlay.getLineHeight()), value);
+		}
+		overlay.draw();
+		glFinish();
+		frame_ms += 0.01f;
+	}
+
+	state.counters["glyphs"] = overlay.getStats().glyphs;
+	state.counters["over_budget"] = double(overlay.getStats().frames_over_budget) / overlay.getStats().frames;
+}
+BENCHMARK(BM_TextOverlay)->Arg(8)->Arg(64)->Arg(256)->Unit(benchmark::kMicrosecond);
+
+//Create, size and release a buffer through its handle, the registry bookkeeping on top of the GL calls
+static void BM_BufferHandle(benchmark::State& state){
+	if (!context){
+		state.SkipWithError("no GL 3.3 context");
+		return;
+	}
+
+	for (auto _ : state){
+		BufferHandle buffer = makeBuffer("benchmark");
+		glBindBuffer(GL_ARRAY_BUFFER, buffer.get());
+		bufferData(buffer, GL_ARRAY_BUFFER, 256, nullptr, GL_STATIC_DRAW);
+	}
+	state.counters["peak_buffers"] = double(ResourceRegistry::get().getUsage(RESOURCE_BUFFER).peak_count);
+}
+BENCHMARK(BM_BufferHandle);
+
+
+//Views spread over hidden windows sharing the benchmark context, two per window like --kiosk
+static void BM_MultiView(benchmark::State& state){
+	if (!scene){
+		state.SkipWithError("no GL 3.3 context");
+		return;
+	}
+
+	std::vector<SceneSprites> scenes(state.range(1));
+	for (std::size_t i = 0; i < scenes.size(); ++i){
+		initSceneSprites(scenes[i]);
+		glm::vec2 offset(float(i % 17) / 8.0f - 1.0f, float(i / 17 % 17) / 8.0f - 1.0f);
+		scenes[i].paddle1.adjustPos(offset);
+		scenes[i].paddle2.adjustPos(offset);
+		scenes[i].ball.adjustPos(offset);
+		scenes[i].title.adjustPos(offset);
+		scenes[i].mario.adjustPos(offset);
+		scenes[i].animationIndex = GLuint(i % scene->frameCount);
+	}
+
+	WorkerPool pool;
+	ViewRenderer views(context, *scene, pool);
+	const std::size_t view_count = std::size_t(state.range(0));
+	for (std::size_t i = 0; i < view_count; i += 2){
+		GLFWwindow* window = views.addWindow(256, 256, "AniDemo Benchmark View", false);
+		if (!window){
+			state.SkipWithError("could not create a shared context");
+			return;
+		}
+		views.addView(window, glm::vec4(0.0f, 0.0f, 0.5f, 1.0f));
+		if (i + 1 < view_count)
+			views.addView(window, glm::vec4(0.5f, 0.0f, 0.5f, 1.0f));
+	}
+	for (std::size_t i = 0; i < view_count; ++i){
+		views.getCamera(i).center = glm::vec2(float(i % 4) - 1.5f, float(i / 4) - 0.5f);
+		views.getCamera(i).half_extent = glm::vec2(0.5f, 1.0f);
+	}
+
+	double prepare_ms = 0.0, submit_ms = 0.0, draw_calls = 0.0;
+	for (auto _ : state){
+		views.prepare(scenes.data(), scenes.size());
+		views.submit();
+		glFinish();
+
+		prepare_ms += views.getStats().prepare_ms;
+		submit_ms += views.getStats().submit_ms;
+		draw_calls += views.getStats().draw_calls;
+	}
+	const double iterations = double(state.iterations());
+	state.counters["prepare_us"] = prepare_ms * 1000.0 / iterations;
+	state.counters["submit_us"] = submit_ms * 1000.0 / iterations;
+	state.counters["draw_calls"] = draw_calls / iterations;
+	state.counters["threads"] = double(pool.size());
+}
+BENCHMARK(BM_MultiView)->ArgsProduct({ { 1, 2, 4, 8 }, { 64, 4096 } })->ArgNames({ "views", "scenes" })
+	->Unit(benchmark::kMicrosecond);
+
+//Packets spread over 4 layers, 8 depth planes, 6 programs and 64 textures with a third blended, reset before every sort
+static void BM_SortPackets(benchmark::State& state){
+	const std::size_t count = std::size_t(state.range(0));
+	std::mt19937 random(1);
+	std::vector<SortEntry> packets(count), entries, scratch;
+	for (std::size_t i = 0; i < count; ++i){
+		BlendMode blend = random() % 3 ? BLEND_OPAQUE : (random() % 2 ? BLEND_ALPHA : BLEND_ADDITIVE);
+		float depth = float(random() % 8) / 7.0f;
+		packets[i] = { makeSortKey(random() % 4, blend, random() % 6, random() % 64, depth), std::uint32_t(i) };
+	}
+
+	WorkerPool pool;
+	WorkerPool* sort_pool = state.range(1) ? &pool : nullptr;
+	for (auto _ : state){
+		state.PauseTiming();
+		entries = packets;
+		state.ResumeTiming();
+		sortEntries(entries, scratch, sort_pool);
+		benchmark::DoNotOptimize(entries.data());
+	}
+	state.counters["state_changes"] = countStateChanges(entries.data(), entries.size());
+	state.counters["unsorted_state_changes"] = countStateChanges(packets.data(), packets.size());
+	state.counters["threads"] = sort_pool ? double(pool.size()) : 1.0;
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SortPackets)->ArgsProduct({ { 1 << 16, 1 << 20 }, { 0, 1 } })->ArgNames({ "packets", "parallel" })
+	->Unit(benchmark::kMillisecond);
+
+int main(int argc, char* argv[]){
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
+
+	{
+		QuietCout quiet;
+		if (!createHeadlessContext())
+			std::cerr << "No GL 3.3 context, the GL benchmarks are skipped" << endl;
+	}
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+
+	scene.reset();
+	ResourceRegistry::get().reportLeaks(stderr);
+	glfwTerminate();
+	return 0;
+}
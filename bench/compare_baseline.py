@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Compare Google Benchmark JSON results against a stored baseline.
+
+    compare_baseline.py baseline.json results.json [--threshold 0.10]
+    compare_baseline.py baseline.json results.json --update
+
+A benchmark regresses when its time grows by more than the threshold
+relative to the baseline.  Medians are used when the run has repetitions.
+Exits 1 on any regression so the check can gate CI.
+"""
+
+import argparse
+import json
+import shutil
+import sys
+
+UNIT_TO_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load_times(path):
+    with open(path) as f:
+        report = json.load(f)
+
+    times = {}
+    medians = {}
+    for bench in report.get("benchmarks", []):
+        if bench.get("error_occurred"):
+            continue
+        time = bench["real_time"] * UNIT_TO_NS[bench.get("time_unit", "ns")]
+        if bench.get("run_type") == "aggregate":
+            if bench.get("aggregate_name") == "median":
+                medians[bench["run_name"]] = time
+        else:
+            times.setdefault(bench.get("run_name", bench["name"]), time)
+
+    times.update(medians)
+    return times
+
+
+def format_ns(ns):
+    for unit in ("s", "ms", "us"):
+        if ns >= UNIT_TO_NS[unit]:
+            return "%.3f %s" % (ns / UNIT_TO_NS[unit], unit)
+    return "%.1f ns" % ns
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative slowdown that counts as a regression")
+    parser.add_argument("--update", action="store_true",
+                        help="replace the baseline with the results")
+    args = parser.parse_args()
+
+    if args.update:
+        shutil.copyfile(args.results, args.baseline)
+        print("Baseline updated from %s" % args.results)
+        return 0
+
+    try:
+        baseline = load_times(args.baseline)
+    except FileNotFoundError:
+        print("No baseline at %s, run the bench_baseline target first" % args.baseline)
+        return 1
+    results = load_times(args.results)
+
+    regressions = 0
+    print("%-40s %14s %14s %9s" % ("Benchmark", "Baseline", "Current", "Change"))
+    for name in sorted(results):
+        current = results[name]
+        if name not in baseline:
+            print("%-40s %14s %14s %9s" % (name, "-", format_ns(current), "new"))
+            continue
+
+        change = current / baseline[name] - 1.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print("%-40s %14s %14s %+8.1f%%%s" % (name, format_ns(baseline[name]),
+                                              format_ns(current), change * 100.0, flag))
+
+    for name in sorted(set(baseline) - set(results)):
+        print("%-40s %14s %14s %9s" % (name, format_ns(baseline[name]), "-", "missing"))
+
+    if regressions:
+        print("%d benchmark(s) regressed by more than %.0f%%" % (regressions, args.threshold * 100.0))
+        return 1
+
+    print("No regressions above %.0f%%" % (args.threshold * 100.0))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())